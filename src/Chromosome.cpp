@@ -34,12 +34,14 @@
 
 
 #include "Chromosome.hpp"
+#include "boost/smart_ptr/detail/atomic_count.hpp"
 #include <iostream>
 #include <iterator>
 #include <stdexcept>
 #include <limits>
 #include <algorithm>
 #include <sstream>
+#include <new>
 
 
 using namespace std;
@@ -96,6 +98,378 @@ bool operator!=(const HaplotypeChunk& a, const HaplotypeChunk& b)
 }
 
 
+//
+// HaplotypeChunks
+//
+
+
+bool HaplotypeChunks::use_inline_storage_ = true;
+
+
+// Heap storage is a single block:  HeapHeader, padded to a multiple of 8 bytes,
+// followed by the chunks.  data_ points to the chunks.
+
+struct HaplotypeChunks::HeapHeader
+{
+    boost::detail::atomic_count use_count;
+
+    HeapHeader() : use_count(1) {}
+};
+
+
+HaplotypeChunks::HaplotypeChunks()
+{
+    initialize_empty();
+}
+
+
+HaplotypeChunks::HaplotypeChunks(const HaplotypeChunks& that)
+{
+    initialize_empty();
+    if (that.empty()) return;
+
+    if (that.storage_ == Storage_Heap && that.size_ > capacity_)
+    {
+        // share
+        ++that.heap_header()->use_count;
+        data_ = that.data_;
+        size_ = that.size_;
+        capacity_ = that.capacity_;
+        storage_ = Storage_Heap;
+        return;
+    }
+
+    if (that.size_ > capacity_) reallocate(that.size_);
+    copy(that.begin(), that.end(), data());
+    size_ = that.size_;
+}
+
+
+HaplotypeChunks& HaplotypeChunks::operator=(const HaplotypeChunks& that)
+{
+    if (this == &that) return *this;
+
+    if (that.size_ <= capacity_ && that.storage_ != Storage_Heap && !shared())
+    {
+        // reuse current storage
+        copy(that.begin(), that.end(), data());
+        size_ = that.size_;
+    }
+    else
+    {
+        HaplotypeChunks temp(that);
+        swap(temp);
+    }
+
+    return *this;
+}
+
+
+void HaplotypeChunks::clear()
+{
+    if (shared())
+    {
+        // other owners keep the buffer
+        release();
+        initialize_empty();
+        return;
+    }
+
+    size_ = 0;
+}
+
+
+void HaplotypeChunks::push_back(const HaplotypeChunk& chunk)
+{
+    if (size_ == capacity_)
+    {
+        HaplotypeChunk temp = chunk; // chunk may refer to our own storage
+        reallocate(max(2*size_t(capacity_), size_t(inline_capacity)));
+        data_[size_++] = temp;
+        return;
+    }
+
+    HaplotypeChunk temp = chunk; // chunk may refer to a shared buffer we detach from
+    mutable_data()[size_++] = temp;
+}
+
+
+void HaplotypeChunks::resize(size_t size, const HaplotypeChunk& chunk)
+{
+    if (size > capacity_)
+    {
+        HaplotypeChunk temp = chunk;
+        reallocate(max(size, 2*size_t(capacity_)));
+        fill(data_ + size_, data_ + size, temp);
+    }
+    else if (size > size_)
+    {
+        HaplotypeChunk temp = chunk;
+        HaplotypeChunk* data = mutable_data();
+        fill(data + size_, data + size, temp);
+    }
+
+    size_ = static_cast<unsigned int>(size);
+}
+
+
+void HaplotypeChunks::reserve(size_t capacity)
+{
+    if (capacity > capacity_)
+        reallocate(capacity);
+    else
+        mutable_data(); // detach, since reserve() precedes writes
+}
+
+
+void HaplotypeChunks::set_size(size_t size)
+{
+    if (size > capacity_)
+        throw runtime_error("[HaplotypeChunks::set_size()] Size exceeds capacity.");
+
+    size_ = static_cast<unsigned int>(size);
+}
+
+
+void HaplotypeChunks::shrink_to_fit()
+{
+    if (storage_ != Storage_Heap || size_ == capacity_ || shared()) return;
+
+    if (use_inline_storage_ && size_ <= inline_capacity)
+    {
+        HaplotypeChunks temp; // inline
+        copy(begin(), end(), temp.begin());
+        temp.size_ = size_;
+        swap(temp);
+        return;
+    }
+
+    reallocate(size_);
+}
+
+
+void HaplotypeChunks::swap(HaplotypeChunks& that)
+{
+    // note: inline_data_ covers data_
+    swap_ranges(inline_data_, inline_data_ + 2*inline_capacity, that.inline_data_);
+    std::swap(size_, that.size_);
+
+    unsigned int temp = capacity_;
+    capacity_ = that.capacity_;
+    that.capacity_ = temp;
+
+    temp = storage_;
+    storage_ = that.storage_;
+    that.storage_ = temp;
+}
+
+
+void HaplotypeChunks::assign(const HaplotypeChunk* begin, const HaplotypeChunk* end, HaplotypeChunkArena& arena)
+{
+    size_t count = end - begin;
+
+    if (use_inline_storage_ && count <= inline_capacity)
+    {
+        HaplotypeChunk temp[inline_capacity]; // [begin, end) may refer to our own storage
+        copy(begin, end, temp);
+
+        release();
+        storage_ = Storage_Inline;
+        capacity_ = inline_capacity;
+        copy(temp, temp + count, data());
+        size_ = static_cast<unsigned int>(count);
+        return;
+    }
+
+    HaplotypeChunk* data = arena.allocate(count);
+    copy(begin, end, data);
+
+    release();
+    data_ = data;
+    size_ = capacity_ = static_cast<unsigned int>(count);
+    storage_ = Storage_Arena;
+}
+
+
+void HaplotypeChunks::share(const HaplotypeChunks& that)
+{
+    if (this == &that) return;
+
+    that.make_shareable();
+
+    HaplotypeChunks temp(that);
+    swap(temp);
+}
+
+
+void HaplotypeChunks::make_shareable() const
+{
+    // moving arena storage to the heap changes only the representation
+    if (storage_ == Storage_Arena)
+        const_cast<HaplotypeChunks*>(this)->reallocate(size_);
+}
+
+
+bool HaplotypeChunks::shared() const
+{
+    return storage_ == Storage_Heap && data_ && heap_header()->use_count > 1;
+}
+
+
+size_t HaplotypeChunks::heap_bytes() const
+{
+    if (storage_ != Storage_Heap || !data_) return 0;
+    return (heap_header_size() + capacity_ * sizeof(HaplotypeChunk)) / heap_header()->use_count;
+}
+
+
+HaplotypeChunk* HaplotypeChunks::allocate_heap(size_t capacity)
+{
+    char* block = static_cast<char*>(::operator new(heap_header_size() + capacity * sizeof(HaplotypeChunk)));
+    new (block) HeapHeader;
+    return reinterpret_cast<HaplotypeChunk*>(block + heap_header_size());
+}
+
+
+size_t HaplotypeChunks::heap_header_size()
+{
+    return (sizeof(HeapHeader) + 7) & ~size_t(7);
+}
+
+
+HaplotypeChunks::HeapHeader* HaplotypeChunks::heap_header() const
+{
+    return reinterpret_cast<HeapHeader*>(reinterpret_cast<char*>(data_) - heap_header_size());
+}
+
+
+void HaplotypeChunks::initialize_empty()
+{
+    data_ = 0;
+    size_ = 0;
+
+    if (use_inline_storage_)
+    {
+        capacity_ = inline_capacity;
+        storage_ = Storage_Inline;
+    }
+    else
+    {
+        capacity_ = 0;
+        storage_ = Storage_Heap;
+    }
+}
+
+
+void HaplotypeChunks::reallocate(size_t capacity)
+{
+    const size_t max_capacity = (1u << 30) - 1;
+    if (capacity > max_capacity)
+        throw runtime_error("[HaplotypeChunks::reallocate()] Capacity too large.");
+
+    HaplotypeChunk* data = allocate_heap(capacity);
+    copy(this->data(), this->data() + size_, data);
+
+    release();
+    data_ = data;
+    capacity_ = static_cast<unsigned int>(capacity);
+    storage_ = Storage_Heap;
+}
+
+
+void HaplotypeChunks::release()
+{
+    if (storage_ == Storage_Heap && data_)
+    {
+        HeapHeader* header = heap_header();
+        if (--header->use_count == 0)
+        {
+            header->~HeapHeader();
+            ::operator delete(header);
+        }
+    }
+
+    data_ = 0;
+    capacity_ = 0;
+    storage_ = Storage_Heap;
+}
+
+
+//
+// HaplotypeChunkArena
+//
+
+
+namespace {
+const size_t default_block_capacity_ = 4096;
+} // namespace
+
+
+HaplotypeChunkArena::HaplotypeChunkArena(size_t initial_capacity)
+:   current_used_(0), size_(0)
+{
+    if (initial_capacity > 0)
+        add_block(initial_capacity);
+}
+
+
+HaplotypeChunkArena::~HaplotypeChunkArena()
+{
+    for (vector<Block>::iterator it=blocks_.begin(); it!=blocks_.end(); ++it)
+        ::operator delete(it->data);
+}
+
+
+HaplotypeChunk* HaplotypeChunkArena::allocate(size_t count)
+{
+    if (blocks_.empty() || current_used_ + count > blocks_.back().capacity)
+    {
+        size_t capacity = blocks_.empty() ? default_block_capacity_ : 2*blocks_.back().capacity;
+        add_block(max(count, capacity));
+    }
+
+    HaplotypeChunk* result = blocks_.back().data + current_used_;
+    current_used_ += count;
+    size_ += count;
+    return result;
+}
+
+
+void HaplotypeChunkArena::reset()
+{
+    if (blocks_.size() > 1)
+    {
+        size_t total_capacity = capacity();
+        for (vector<Block>::iterator it=blocks_.begin(); it!=blocks_.end(); ++it)
+            ::operator delete(it->data);
+        blocks_.clear();
+        add_block(total_capacity);
+    }
+
+    current_used_ = 0;
+    size_ = 0;
+}
+
+
+size_t HaplotypeChunkArena::capacity() const
+{
+    size_t result = 0;
+    for (vector<Block>::const_iterator it=blocks_.begin(); it!=blocks_.end(); ++it)
+        result += it->capacity;
+    return result;
+}
+
+
+void HaplotypeChunkArena::add_block(size_t capacity)
+{
+    Block block;
+    block.data = static_cast<HaplotypeChunk*>(::operator new(capacity * sizeof(HaplotypeChunk)));
+    block.capacity = capacity;
+    blocks_.push_back(block);
+    current_used_ = 0;
+}
+
+
 //
 // ChromosomeEncodedID
 //
@@ -171,20 +545,23 @@ Chromosome::Chromosome(const HaplotypeChunks& haplotype_chunks)
 
 Chromosome::Chromosome(const Chromosome& x, const Chromosome& y, const vector<unsigned int>& positions)
 {
-    bool copy_from_x = true; // false == copy from y
-    size_t position_previous = 0;
+    recombine(x, y, positions, haplotype_chunks_);
+    haplotype_chunks_.shrink_to_fit();
+}
 
-    for (vector<unsigned int>::const_iterator position=positions.begin(); position!=positions.end(); ++position)
-    {
-        const Chromosome* p = copy_from_x ? &x : &y;
-        p->extract_haplotype_chunks(position_previous, *position, haplotype_chunks_);
 
-        copy_from_x = !copy_from_x; 
-        position_previous = *position;
+void Chromosome::recombine(const Chromosome& x, const Chromosome& y, const vector<unsigned int>& positions,
+                           HaplotypeChunks& result)
+{
+    if (const Chromosome* source = nonrecombinant_source(x, y, positions))
+    {
+        result.share(source->haplotype_chunks_);
+        return;
     }
 
-    const Chromosome* p = copy_from_x ? &x : &y;
-    p->extract_haplotype_chunks(position_previous, numeric_limits<unsigned int>::max(), haplotype_chunks_);
+    result.clear();
+    result.reserve(recombine_size_bound(x, y, positions));
+    result.set_size(recombine(x, y, positions, result.begin()));
 }
 
 
@@ -216,6 +593,53 @@ struct ComparePosition
 } // namespace
 
 
+size_t Chromosome::recombine(const Chromosome& x, const Chromosome& y, const vector<unsigned int>& positions,
+                             HaplotypeChunk* result)
+{
+    // Segment k of the child, [positions[k-1], positions[k]), comes from x for even k, 
+    // y for odd k.  For each source, cursor[] tracks the chunk containing the start
+    // of the current segment; since positions are sorted, cursors only move forward.
+
+    const HaplotypeChunks* sources[] = {&x.haplotype_chunks_, &y.haplotype_chunks_};
+    const HaplotypeChunk* cursor[] = {sources[0]->begin(), sources[1]->begin()};
+
+    if (sources[0]->empty() || sources[1]->empty())
+        throw runtime_error("[Chromosome::recombine()] Empty parental chromosome.");
+
+    HaplotypeChunk* out = result;
+    size_t which = 0;
+    unsigned int segment_begin = 0;
+
+    for (size_t k=0; k<=positions.size(); ++k, which^=1)
+    {
+        const unsigned int segment_end = k<positions.size() ? positions[k] : numeric_limits<unsigned int>::max();
+        if (segment_end <= segment_begin) continue; // empty segment
+
+        const HaplotypeChunk* source_end = sources[which]->end();
+
+        // chunk containing segment_begin
+        const HaplotypeChunk* chunk = upper_bound(cursor[which], source_end, 
+                                                  HaplotypeChunk(segment_begin, 0), ComparePosition());
+        if (chunk == cursor[which])
+            throw runtime_error("[Chromosome::recombine()] Parental chromosome does not begin at position 0.");
+        --chunk;
+
+        if (out == result || (out-1)->id != chunk->id)
+            *out++ = HaplotypeChunk(segment_begin, chunk->id);
+
+        // remaining chunks starting within the segment
+        for (++chunk; chunk != source_end && chunk->position < segment_end; ++chunk)
+            if ((out-1)->id != chunk->id)
+                *out++ = *chunk;
+
+        cursor[which] = chunk - 1;
+        segment_begin = segment_end;
+    }
+
+    return out - result;
+}
+
+
 HaplotypeChunks::iterator Chromosome::find_haplotype_chunk(unsigned int position, size_t index_begin)
 {
     if (index_begin >= haplotype_chunks_.size()) throw runtime_error("[Chromosome::find_haplotype_chunk()] Bad index_begin.");
@@ -242,7 +666,7 @@ void Chromosome::read(istream& is)
     is.read((char*)&haplotype_chunk_count, sizeof(size_t));
     if (haplotype_chunk_count > 10000) throw runtime_error("[Chromosome::read()] Bad haplotype_chunk_count.");
     haplotype_chunks_.resize(haplotype_chunk_count);
-    is.read((char*)&haplotype_chunks_[0], sizeof(HaplotypeChunk)*haplotype_chunk_count);
+    is.read((char*)haplotype_chunks_.begin(), sizeof(HaplotypeChunk)*haplotype_chunk_count);
 }
 
 
@@ -250,7 +674,7 @@ void Chromosome::write(ostream& os) const
 {
     size_t haplotype_chunk_count = haplotype_chunks_.size();
     os.write((const char*)&haplotype_chunk_count, sizeof(size_t));
-    os.write((const char*)&haplotype_chunks_[0], sizeof(HaplotypeChunk)*haplotype_chunk_count);
+    os.write((const char*)haplotype_chunks_.begin(), sizeof(HaplotypeChunk)*haplotype_chunk_count);
 }
 
 
@@ -39,6 +39,7 @@
 
 #include <iosfwd>
 #include <vector>
+#include <cstddef>
 
 
 struct HaplotypeChunk
@@ -50,7 +51,193 @@ struct HaplotypeChunk
 };
 
 
-typedef std::vector<HaplotypeChunk> HaplotypeChunks;
+class HaplotypeChunkArena;
+
+
+//
+// HaplotypeChunks: vector-like container of HaplotypeChunk
+//
+// Storage is one of:
+//  - inline: up to inline_capacity chunks held in the object itself
+//  - heap: reference-counted buffer, copy-on-write
+//  - arena: a fixed-size view into a HaplotypeChunkArena, valid until the 
+//    arena is reset
+//
+// Copies are always inline or heap.  Copies of heap storage share the buffer;
+// non-const access to a shared buffer first makes a private copy.  Growing 
+// beyond the current storage (inline buffer or arena slot) migrates to the heap.
+//
+// Inline storage may be disabled globally (e.g. for benchmarking), in which
+// case new containers start out empty on the heap.
+//
+
+class HaplotypeChunks
+{
+    public:
+
+    typedef HaplotypeChunk value_type;
+    typedef HaplotypeChunk& reference;
+    typedef const HaplotypeChunk& const_reference;
+    typedef HaplotypeChunk* pointer;
+    typedef const HaplotypeChunk* const_pointer;
+    typedef HaplotypeChunk* iterator;
+    typedef const HaplotypeChunk* const_iterator;
+    typedef size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    enum {inline_capacity = 4};
+    enum Storage {Storage_Inline, Storage_Heap, Storage_Arena};
+
+    HaplotypeChunks();
+    HaplotypeChunks(const HaplotypeChunks& that);
+    HaplotypeChunks& operator=(const HaplotypeChunks& that);
+    ~HaplotypeChunks() {release();}
+
+    iterator begin() {return mutable_data();}
+    const_iterator begin() const {return data();}
+    iterator end() {return mutable_data() + size_;}
+    const_iterator end() const {return data() + size_;}
+
+    size_t size() const {return size_;}
+    size_t capacity() const {return capacity_;}
+    bool empty() const {return size_ == 0;}
+
+    HaplotypeChunk& operator[](size_t index) {return mutable_data()[index];}
+    const HaplotypeChunk& operator[](size_t index) const {return data()[index];}
+    HaplotypeChunk& front() {return mutable_data()[0];}
+    const HaplotypeChunk& front() const {return data()[0];}
+    HaplotypeChunk& back() {return mutable_data()[size_-1];}
+    const HaplotypeChunk& back() const {return data()[size_-1];}
+
+    // mutating members detach from a shared buffer (clear() drops it)
+    void clear();
+    void push_back(const HaplotypeChunk& chunk);
+    void resize(size_t size, const HaplotypeChunk& chunk = HaplotypeChunk());
+    void reserve(size_t capacity);
+    void swap(HaplotypeChunks& that);
+
+    // sets size() (at most capacity()) without initializing new chunks, after 
+    // they have been written through begin() into storage obtained by reserve()
+    void set_size(size_t size);
+
+    // reduces capacity() to size():  inline storage if it fits, otherwise an
+    // exact heap buffer;  arena and shared storage are left as is
+    void shrink_to_fit();
+
+    // replace contents with a copy of [begin, end), stored inline if possible,
+    // otherwise in the arena
+    void assign(const HaplotypeChunk* begin, const HaplotypeChunk* end, HaplotypeChunkArena& arena);
+
+    // replace contents with those of that, sharing its buffer;  arena storage
+    // in that is first moved to the heap by make_shareable(), so this must 
+    // not be called concurrently with the same that unless that.make_shareable()
+    // has already been called
+    void share(const HaplotypeChunks& that);
+
+    // moves arena storage to the heap (contents unchanged); afterwards share()
+    // only reads this
+    void make_shareable() const;
+
+    Storage storage() const {return static_cast<Storage>(storage_);}
+    bool uses_arena() const {return storage_ == Storage_Arena;}
+    bool uses_inline() const {return storage_ == Storage_Inline;}
+    bool shared() const; // heap buffer with other owners
+
+    // bytes owned on the heap (not including sizeof(HaplotypeChunks)); a shared
+    // buffer is divided evenly among its owners
+    size_t heap_bytes() const;
+
+    // global switch for inline storage (default: true)
+    static void use_inline_storage(bool value) {use_inline_storage_ = value;}
+    static bool use_inline_storage() {return use_inline_storage_;}
+
+    private:
+
+    union
+    {
+        HaplotypeChunk* data_;                            // heap, arena
+        unsigned int inline_data_[2*inline_capacity];     // inline
+    };
+
+    unsigned int size_;
+    unsigned int capacity_ : 30;
+    unsigned int storage_ : 2;
+
+    static bool use_inline_storage_;
+
+    struct HeapHeader; // reference count, preceding heap storage
+
+    HaplotypeChunk* data() 
+    {
+        return storage_ == Storage_Inline ? reinterpret_cast<HaplotypeChunk*>(inline_data_) : data_;
+    }
+
+    const HaplotypeChunk* data() const 
+    {
+        return storage_ == Storage_Inline ? reinterpret_cast<const HaplotypeChunk*>(inline_data_) : data_;
+    }
+
+    HaplotypeChunk* mutable_data() // data() for writing:  detaches from shared buffer
+    {
+        if (storage_ == Storage_Heap && data_ && shared()) reallocate(capacity_);
+        return data();
+    }
+
+    static HaplotypeChunk* allocate_heap(size_t capacity);
+    static size_t heap_header_size();
+    HeapHeader* heap_header() const;
+    void initialize_empty();
+    void reallocate(size_t capacity); // moves contents to new (unshared) heap storage
+    void release();
+};
+
+
+//
+// HaplotypeChunkArena: generation-scoped slab allocator for HaplotypeChunks
+//
+// allocate() bumps a pointer within the current block, adding a block if
+// necessary.  reset() invalidates all outstanding allocations and coalesces 
+// the blocks into a single block, so that a recycled arena serving a 
+// generation of similar size makes no further allocator calls.
+//
+
+class HaplotypeChunkArena
+{
+    public:
+
+    HaplotypeChunkArena(size_t initial_capacity = 0);
+    ~HaplotypeChunkArena();
+
+    HaplotypeChunk* allocate(size_t count);
+    void reset();
+
+    size_t size() const {return size_;} // chunks allocated since last reset
+    size_t capacity() const;            // chunks available in all blocks
+    size_t block_count() const {return blocks_.size();}
+
+    // scratch buffer for building chromosomes before copying into the arena
+    HaplotypeChunks& scratch() {return scratch_;}
+
+    private:
+
+    struct Block
+    {
+        HaplotypeChunk* data;
+        size_t capacity;
+    };
+
+    std::vector<Block> blocks_;
+    size_t current_used_; // chunks used in blocks_.back()
+    size_t size_;
+    HaplotypeChunks scratch_;
+
+    void add_block(size_t capacity);
+
+    // disallow copying
+    HaplotypeChunkArena(HaplotypeChunkArena&);
+    HaplotypeChunkArena& operator=(HaplotypeChunkArena&);
+};
+
 
 
 std::ostream& operator<<(std::ostream& os, const HaplotypeChunk& x);
@@ -80,6 +267,34 @@ class Chromosome
     //  - 0 in positions <--> start with y
     Chromosome(const Chromosome& x, const Chromosome& y, const std::vector<unsigned int>& positions); 
 
+    // recombination kernel: single pass over the parental HaplotypeChunks, writing
+    // canonical HaplotypeChunks to caller-provided storage (adjacent chunks with equal
+    // ids are merged, empty segments dropped);  result must have room for 
+    // recombine_size_bound() chunks; returns the number of chunks written
+    static size_t recombine(const Chromosome& x, const Chromosome& y, const std::vector<unsigned int>& positions,
+                            HaplotypeChunk* result);
+
+    static size_t recombine_size_bound(const Chromosome& x, const Chromosome& y, const std::vector<unsigned int>& positions)
+    {
+        return x.haplotype_chunks_.size() + y.haplotype_chunks_.size() + positions.size() + 1;
+    }
+
+    // non-recombinant transmission: returns the parental chromosome passed on 
+    // whole (&x or &y), or 0 if positions contain a crossover
+    static const Chromosome* nonrecombinant_source(const Chromosome& x, const Chromosome& y, 
+                                                   const std::vector<unsigned int>& positions)
+    {
+        if (!positions.empty() && positions.back() != 0) return 0;
+        return positions.size()%2 ? &y : &x;
+    }
+
+    // recombination, replacing the contents of result;  non-recombinant 
+    // transmission shares the parental HaplotypeChunks.  The kernel writes into
+    // result's reserved storage, which keeps capacity recombine_size_bound(), so
+    // that result can be reused as scratch;  Chromosome() shrinks it to fit.
+    static void recombine(const Chromosome& x, const Chromosome& y, const std::vector<unsigned int>& positions,
+                          HaplotypeChunks& result);
+
     // access to HaplotypeChunks
     HaplotypeChunks& haplotype_chunks() {return haplotype_chunks_;}
     const HaplotypeChunks& haplotype_chunks() const {return haplotype_chunks_;}
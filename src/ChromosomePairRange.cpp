@@ -46,7 +46,7 @@ using namespace std;
 
 
 ChromosomePairRange::ChromosomePairRange(ChromosomePairs& chromosome_pairs)
-:   begin_(0), end_(0)
+:   begin_(0), end_(0), arena_(0)
 {
     if (!chromosome_pairs.empty())
     {
@@ -58,6 +58,20 @@ ChromosomePairRange::ChromosomePairRange(ChromosomePairs& chromosome_pairs)
 
 void ChromosomePairRange::create_child(unsigned int id0, unsigned int id1)
 {
+    if (arena_)
+    {
+        const HaplotypeChunk chunk0(0, id0);
+        const HaplotypeChunk chunk1(0, id1);
+
+        for (ChromosomePair* p=begin_; p!=end_; ++p)
+        {
+            p->first.haplotype_chunks().assign(&chunk0, &chunk0 + 1, *arena_);
+            p->second.haplotype_chunks().assign(&chunk1, &chunk1 + 1, *arena_);
+        }
+
+        return;
+    }
+
     for (ChromosomePair* p=begin_; p!=end_; ++p)
     {
         p->first.haplotype_chunks().clear();
@@ -68,15 +82,34 @@ void ChromosomePairRange::create_child(unsigned int id0, unsigned int id1)
 }
 
 
+namespace {
+
+void transmit(const ChromosomePair& parent, const vector<unsigned int>& positions,
+              Chromosome& child, HaplotypeChunkArena& arena)
+{
+    // non-recombinant: share the parent's HaplotypeChunks
+    
+    if (const Chromosome* source = Chromosome::nonrecombinant_source(parent.first, parent.second, positions))
+    {
+        child.haplotype_chunks().share(source->haplotype_chunks());
+        return;
+    }
+
+    // recombine into the arena's scratch buffer, then copy exact size into the arena
+
+    HaplotypeChunks& scratch = arena.scratch();
+    Chromosome::recombine(parent.first, parent.second, positions, scratch);
+    child.haplotype_chunks().assign(scratch.begin(), scratch.end(), arena);
+}
+
+} // namespace
+
+
 void ChromosomePairRange::create_child(const ChromosomePairRange& mom,
                                        const ChromosomePairRange& dad,
                                        const RecombinationPositionGeneratorPtrs& recombination_position_generators)
 {
-    if (mom.size() != dad.size())
-        throw runtime_error("[ChromosomePairRange::create_child()] Parents chromosome counts differ.");
-
-    if (mom.size() != this->size())
-        throw runtime_error("[ChromosomePairRange::create_child()] Parents chromosome counts differ from child.");
+    check_parents(mom, dad);
 
     if (recombination_position_generators.size() != 2)
         throw runtime_error("[ChromosomePairRange::create_child()] Recombination position generator count != 2.");
@@ -85,18 +118,62 @@ void ChromosomePairRange::create_child(const ChromosomePairRange& mom,
     const ChromosomePair* p_mom = mom.begin();
     const ChromosomePair* p_dad = dad.begin();
     ChromosomePair* p_baby = this->begin();
+    vector<unsigned int> positions_mom;
+    vector<unsigned int> positions_dad;
 
     for (; p_mom!=mom.end(); ++p_mom, ++p_dad, ++p_baby, ++chromosome_pair_index)
     {
-        vector<unsigned int> positions_mom = recombination_position_generators[0]->get_positions(chromosome_pair_index);
-        vector<unsigned int> positions_dad = recombination_position_generators[1]->get_positions(chromosome_pair_index);
+        positions_mom.clear();
+        positions_dad.clear();
+        recombination_position_generators[0]->append_positions(chromosome_pair_index, positions_mom);
+        recombination_position_generators[1]->append_positions(chromosome_pair_index, positions_dad);
+        create_child_pair(*p_mom, *p_dad, positions_mom, positions_dad, *p_baby);
+    }
+}
+
 
-        Chromosome chromosome_mom(p_mom->first, p_mom->second, positions_mom);
-        p_baby->first.haplotype_chunks().swap(chromosome_mom.haplotype_chunks());
+void ChromosomePairRange::create_child(const ChromosomePairRange& mom,
+                                       const ChromosomePairRange& dad,
+                                       const vector<unsigned int>* positions)
+{
+    check_parents(mom, dad);
+
+    const ChromosomePair* p_mom = mom.begin();
+    const ChromosomePair* p_dad = dad.begin();
+    ChromosomePair* p_baby = this->begin();
+
+    for (; p_mom!=mom.end(); ++p_mom, ++p_dad, ++p_baby, positions+=2)
+        create_child_pair(*p_mom, *p_dad, positions[0], positions[1], *p_baby);
+}
 
-        Chromosome chromosome_dad(p_dad->first, p_dad->second, positions_dad);
-        p_baby->second.haplotype_chunks().swap(chromosome_dad.haplotype_chunks());
+
+void ChromosomePairRange::check_parents(const ChromosomePairRange& mom, const ChromosomePairRange& dad) const
+{
+    if (mom.size() != dad.size())
+        throw runtime_error("[ChromosomePairRange::create_child()] Parents chromosome counts differ.");
+
+    if (mom.size() != this->size())
+        throw runtime_error("[ChromosomePairRange::create_child()] Parents chromosome counts differ from child.");
+}
+
+
+void ChromosomePairRange::create_child_pair(const ChromosomePair& mom, const ChromosomePair& dad,
+                                            const vector<unsigned int>& positions_mom,
+                                            const vector<unsigned int>& positions_dad,
+                                            ChromosomePair& baby)
+{
+    if (arena_)
+    {
+        transmit(mom, positions_mom, baby.first, *arena_);
+        transmit(dad, positions_dad, baby.second, *arena_);
+        return;
     }
+
+    Chromosome chromosome_mom(mom.first, mom.second, positions_mom);
+    baby.first.haplotype_chunks().swap(chromosome_mom.haplotype_chunks());
+
+    Chromosome chromosome_dad(dad.first, dad.second, positions_dad);
+    baby.second.haplotype_chunks().swap(chromosome_dad.haplotype_chunks());
 }
 
 
@@ -136,9 +213,10 @@ ChromosomePairRangeIterator::ChromosomePairRangeIterator(Organisms::iterator it)
 
 
 ChromosomePairRangeIterator::ChromosomePairRangeIterator(ChromosomePair* begin, 
-                                                         size_t chromosome_pair_count)
+                                                         size_t chromosome_pair_count,
+                                                         HaplotypeChunkArena* arena)
 :   using_organism_implementation_(false), 
-    current_(begin, begin + chromosome_pair_count),
+    current_(begin, begin + chromosome_pair_count, arena),
     chromosome_pair_count_(chromosome_pair_count)
 {
     // The "pool" implementation assumes that the ChromosomePairs are held in a 2D array
@@ -44,8 +44,8 @@ class ChromosomePairRange
 {
     public:
 
-    ChromosomePairRange(ChromosomePair* begin = 0, ChromosomePair* end = 0)
-    :   begin_(begin), end_(end)
+    ChromosomePairRange(ChromosomePair* begin = 0, ChromosomePair* end = 0, HaplotypeChunkArena* arena = 0)
+    :   begin_(begin), end_(end), arena_(arena)
     {}
 
     ChromosomePairRange(ChromosomePairs& chromosome_pairs);
@@ -58,6 +58,9 @@ class ChromosomePairRange
 
     size_t size() const {return end_ - begin_;}
 
+    // if non-null, create_child() stores HaplotypeChunks in the arena
+    HaplotypeChunkArena* arena() const {return arena_;}
+
     void step(int step_size) {begin_ += step_size; end_ += step_size;}
 
 
@@ -69,12 +72,26 @@ class ChromosomePairRange
                       const ChromosomePairRange& dad,
                       const RecombinationPositionGeneratorPtrs& recombination_position_generators);
 
+    // recombination positions given by caller:  positions[2*i] and positions[2*i+1]
+    // for the maternal and paternal chromosomes of pair i
+    void create_child(const ChromosomePairRange& mom,
+                      const ChromosomePairRange& dad,
+                      const std::vector<unsigned int>* positions);
+
     bool equals(const ChromosomePairRange& that) const; // deep equality comparison
 
     private:
 
     ChromosomePair* begin_;
     ChromosomePair* end_;
+    HaplotypeChunkArena* arena_;
+
+    void check_parents(const ChromosomePairRange& mom, const ChromosomePairRange& dad) const;
+
+    void create_child_pair(const ChromosomePair& mom, const ChromosomePair& dad,
+                           const std::vector<unsigned int>& positions_mom,
+                           const std::vector<unsigned int>& positions_dad,
+                           ChromosomePair& baby);
 };
 
 
@@ -83,7 +100,8 @@ class ChromosomePairRangeIterator
     public:
 
     ChromosomePairRangeIterator(Organisms::iterator it);
-    ChromosomePairRangeIterator(ChromosomePair* begin, size_t chromosome_pair_count = 0);
+    ChromosomePairRangeIterator(ChromosomePair* begin, size_t chromosome_pair_count = 0,
+                                HaplotypeChunkArena* arena = 0);
 
     ChromosomePairRange& operator*();
     const ChromosomePairRange& operator*() const;
@@ -40,6 +40,7 @@
 #include <map>
 #include <cstring>
 #include <algorithm>
+#include <cstdlib>
 
 
 BOOST_STATIC_ASSERT(sizeof(HaplotypeChunk) == 8); // make sure int is 32-bit
@@ -590,6 +591,111 @@ void test_recombine_4()
 }
 
 
+void test_recombine_canonical()
+{
+    if (os_) *os_ << "test_recombine_canonical()\n";
+
+    // crossovers between segments with the same id leave no breakpoint
+
+    HaplotypeChunks chunks_a;
+    chunks_a.push_back(HaplotypeChunk(0, 1));
+    chunks_a.push_back(HaplotypeChunk(1000, 2));
+    chunks_a.push_back(HaplotypeChunk(2000, 3));
+
+    HaplotypeChunks chunks_b;
+    chunks_b.push_back(HaplotypeChunk(0, 1));
+    chunks_b.push_back(HaplotypeChunk(1500, 2));
+    chunks_b.push_back(HaplotypeChunk(2500, 4));
+
+    Chromosome a(chunks_a);
+    Chromosome b(chunks_b);
+
+    vector<unsigned int> positions;
+    positions.push_back(500);   // a -> b within id 1
+    positions.push_back(1800);  // b -> a within id 2
+    positions.push_back(1800);  // empty segment from a
+    positions.push_back(1900);  // b -> a within id 2
+
+    Chromosome c(a, b, positions);
+    if (os_) *os_ << "c: " << c << endl;
+
+    unit_assert(c.haplotype_chunks().size() == 3);
+    unit_assert(c.haplotype_chunks()[0] == HaplotypeChunk(0, 1));
+    unit_assert(c.haplotype_chunks()[1] == HaplotypeChunk(1500, 2));
+    unit_assert(c.haplotype_chunks()[2] == HaplotypeChunk(2000, 3));
+
+    // kernel writes into caller storage
+
+    HaplotypeChunk buffer[16];
+    unit_assert(Chromosome::recombine_size_bound(a, b, positions) <= 16);
+    size_t count = Chromosome::recombine(a, b, positions, buffer);
+    unit_assert(count == 3);
+    unit_assert(equal(buffer, buffer + count, c.haplotype_chunks().begin()));
+
+    if (os_) *os_ << endl;
+}
+
+
+void test_recombine_random()
+{
+    if (os_) *os_ << "test_recombine_random()\n";
+
+    // compare kernel output with direct evaluation: at position p, the child 
+    // comes from y iff an odd number of crossover positions are <= p
+
+    srand(123);
+
+    for (size_t iteration=0; iteration<1000; ++iteration)
+    {
+        Chromosome parents[2];
+        for (size_t i=0; i<2; ++i)
+        {
+            HaplotypeChunks chunks;
+            chunks.push_back(HaplotypeChunk(0, rand()%3));
+            for (size_t j=rand()%10; j>0; --j)
+                chunks.push_back(HaplotypeChunk(chunks.back().position + 1 + rand()%100, rand()%3));
+            parents[i] = Chromosome(chunks);
+        }
+
+        vector<unsigned int> positions;
+        for (size_t j=rand()%6; j>0; --j)
+            positions.push_back(rand()%1000);
+        sort(positions.begin(), positions.end());
+
+        Chromosome child(parents[0], parents[1], positions);
+        const HaplotypeChunks& chunks = child.haplotype_chunks();
+
+        unit_assert(chunks.size() <= Chromosome::recombine_size_bound(parents[0], parents[1], positions));
+        unit_assert(!chunks.empty() && chunks.front().position == 0);
+
+        // non-recombinant transmission shares the parent as is; otherwise canonical,
+        // and sized exactly
+
+        const Chromosome* source = Chromosome::nonrecombinant_source(parents[0], parents[1], positions);
+
+        if (!source)
+            unit_assert(chunks.uses_inline() || chunks.capacity() == chunks.size());
+
+        if (source)
+            unit_assert(child == *source);
+
+        for (size_t j=1; j<chunks.size() && !source; ++j)
+        {
+            unit_assert(chunks[j-1].position < chunks[j].position);
+            unit_assert(chunks[j-1].id != chunks[j].id);
+        }
+
+        for (unsigned int p=0; p<1100; ++p)
+        {
+            size_t which = (upper_bound(positions.begin(), positions.end(), p) - positions.begin()) % 2;
+            unit_assert(child.find_haplotype_chunk(p)->id == parents[which].find_haplotype_chunk(p)->id);
+        }
+    }
+
+    if (os_) *os_ << endl;
+}
+
+
 void test_write_read_binary()
 {
     if (os_) *os_ << "test_write_read_binary()\n";
@@ -657,10 +763,337 @@ void test_find_haplotype_chunk()
 }
 
 
+void test_HaplotypeChunks()
+{
+    if (os_) *os_ << "test_HaplotypeChunks()\n";
+
+    HaplotypeChunks a;
+    unit_assert(a.empty());
+    for (unsigned int i=0; i<10; i++)
+        a.push_back(HaplotypeChunk(i*1000, i));
+    unit_assert(a.size() == 10);
+    unit_assert(a.capacity() >= 10);
+    unit_assert(a.front() == HaplotypeChunk(0, 0));
+    unit_assert(a.back() == HaplotypeChunk(9000, 9));
+    unit_assert(!a.uses_arena());
+
+    HaplotypeChunks b(a); // copy-on-write
+    unit_assert(b.size() == 10);
+    unit_assert(b.begin() != a.begin());
+    unit_assert(equal(a.begin(), a.end(), b.begin()));
+
+    b[3].id = 666;
+    unit_assert(a[3].id == 3);
+
+    HaplotypeChunks c;
+    c = b;
+    unit_assert(c.size() == 10 && c[3].id == 666);
+
+    c.swap(a);
+    unit_assert(c[3].id == 3 && a[3].id == 666);
+
+    c.resize(12, HaplotypeChunk(12000, 12));
+    unit_assert(c.size() == 12);
+    unit_assert(c.back() == HaplotypeChunk(12000, 12));
+
+    c.clear();
+    unit_assert(c.empty());
+
+    if (os_) *os_ << endl;
+}
+
+
+void test_HaplotypeChunks_inline()
+{
+    if (os_) *os_ << "test_HaplotypeChunks_inline()\n";
+
+    BOOST_STATIC_ASSERT(sizeof(HaplotypeChunks) == 40);
+
+    HaplotypeChunks a;
+    unit_assert(a.uses_inline());
+    unit_assert(a.capacity() == HaplotypeChunks::inline_capacity);
+
+    for (unsigned int i=0; i<HaplotypeChunks::inline_capacity; i++)
+        a.push_back(HaplotypeChunk(i*1000, i));
+    unit_assert(a.uses_inline());
+    unit_assert(a.heap_bytes() == 0);
+
+    // spill to heap
+
+    HaplotypeChunks b(a);
+    b.push_back(HaplotypeChunk(4000, 4));
+    unit_assert(b.storage() == HaplotypeChunks::Storage_Heap);
+    unit_assert(b.size() == 5);
+    unit_assert(b.heap_bytes() >= b.capacity() * sizeof(HaplotypeChunk));
+    unit_assert(equal(a.begin(), a.end(), b.begin()));
+
+    // swap inline <-> heap
+
+    a.swap(b);
+    unit_assert(a.size() == 5 && a.storage() == HaplotypeChunks::Storage_Heap);
+    unit_assert(b.size() == 4 && b.uses_inline());
+    unit_assert(a[4] == HaplotypeChunk(4000, 4));
+    unit_assert(b[3] == HaplotypeChunk(3000, 3));
+
+    // small assignments from arena are stored inline
+
+    HaplotypeChunkArena arena;
+    HaplotypeChunks c;
+    c.assign(b.begin(), b.begin() + 2, arena);
+    unit_assert(c.uses_inline());
+    unit_assert(c.size() == 2);
+    unit_assert(arena.size() == 0);
+
+    // Chromosome read/write/find with inline storage
+
+    Chromosome chromosome(c);
+    unit_assert(chromosome.haplotype_chunks().uses_inline());
+    unit_assert(chromosome.find_haplotype_chunk(1500)->id == 1);
+
+    ostringstream oss;
+    chromosome.write(oss);
+    istringstream iss(oss.str());
+    Chromosome chromosome2;
+    chromosome2.read(iss);
+    unit_assert(chromosome2.haplotype_chunks().uses_inline());
+    unit_assert(chromosome == chromosome2);
+
+    // writing into reserved storage, then shrinking to fit
+
+    HaplotypeChunks f;
+    f.reserve(10);
+    copy(a.begin(), a.end(), f.begin());
+    f.set_size(a.size());
+    unit_assert(f.size() == 5 && f.capacity() == 10);
+    unit_assert(equal(a.begin(), a.end(), f.begin()));
+    unit_assert_throws(f.set_size(11), runtime_error);
+
+    f.shrink_to_fit();
+    unit_assert(f.storage() == HaplotypeChunks::Storage_Heap && f.capacity() == 5);
+    unit_assert(equal(a.begin(), a.end(), f.begin()));
+
+    f.set_size(3);
+    f.shrink_to_fit();
+    unit_assert(f.uses_inline() && f.size() == 3);
+    unit_assert(equal(f.begin(), f.end(), a.begin()));
+
+    // global switch
+
+    HaplotypeChunks::use_inline_storage(false);
+    HaplotypeChunks d;
+    HaplotypeChunks e(b);
+    unit_assert(d.storage() == HaplotypeChunks::Storage_Heap && d.capacity() == 0);
+    unit_assert(e.storage() == HaplotypeChunks::Storage_Heap);
+    unit_assert(e.size() == b.size() && equal(b.begin(), b.end(), e.begin()));
+    HaplotypeChunks::use_inline_storage(true);
+
+    if (os_) *os_ << endl;
+}
+
+
+void test_HaplotypeChunks_shared()
+{
+    if (os_) *os_ << "test_HaplotypeChunks_shared()\n";
+
+    HaplotypeChunks a;
+    for (unsigned int i=0; i<10; i++)
+        a.push_back(HaplotypeChunk(i*1000, i));
+    unit_assert(!a.shared());
+    size_t bytes = a.heap_bytes();
+
+    // copies share the heap buffer
+
+    HaplotypeChunks b(a);
+    const HaplotypeChunks& a_const = a;
+    const HaplotypeChunks& b_const = b;
+    unit_assert(a.shared() && b.shared());
+    unit_assert(b_const.begin() == a_const.begin());
+    unit_assert(a.heap_bytes() + b.heap_bytes() == bytes);
+
+    HaplotypeChunks c;
+    c = a;
+    unit_assert(c.size() == 10 && c.shared());
+
+    // writes detach
+
+    c[3].id = 666;
+    unit_assert(!c.shared() && c[3].id == 666);
+    unit_assert(a[3].id == 3 && b_const[3].id == 3);
+    unit_assert(!a.shared() && !b.shared()); // a detached on non-const access
+
+    b.push_back(HaplotypeChunk(10000, 10));
+    unit_assert(b.size() == 11 && a.size() == 10);
+
+    // share() moves arena storage to the heap
+
+    HaplotypeChunkArena arena;
+    HaplotypeChunks d, e;
+    d.assign(a_const.begin(), a_const.end(), arena);
+    unit_assert(d.uses_arena());
+    e.share(d);
+    unit_assert(!d.uses_arena() && d.shared() && e.shared());
+    unit_assert(equal(a_const.begin(), a_const.end(), e.begin()));
+
+    // non-recombinant transmission shares the parental buffer
+
+    HaplotypeChunks f;
+    for (unsigned int i=0; i<5; i++)
+        f.push_back(HaplotypeChunk(i*2000, 100+i));
+
+    const Chromosome x(a), y(f);
+    const Chromosome child(x, y, vector<unsigned int>());
+    unit_assert(child.haplotype_chunks().shared());
+    unit_assert(child.haplotype_chunks().begin() == x.haplotype_chunks().begin());
+
+    vector<unsigned int> positions(1, 0); // start with y
+    const Chromosome child2(x, y, positions);
+    unit_assert(child2 == y);
+    unit_assert(child2.haplotype_chunks().begin() == y.haplotype_chunks().begin());
+
+    positions.push_back(5500); // crossover: new buffer
+    Chromosome child3(x, y, positions);
+    unit_assert(!child3.haplotype_chunks().shared());
+    unit_assert(child3.haplotype_chunks().size() == 8);
+
+    if (os_) *os_ << endl;
+}
+
+
+void test_HaplotypeChunks_shared_mutation()
+{
+    if (os_) *os_ << "test_HaplotypeChunks_shared_mutation()\n";
+
+    // mutating one owner of a shared buffer leaves the other owners unchanged
+
+    HaplotypeChunks a;
+    for (unsigned int i=0; i<10; i++)
+        a.push_back(HaplotypeChunk(i*1000, 100+i));
+    const HaplotypeChunks a_copy = a; // shares too
+    const HaplotypeChunks& a_const = a;
+
+    // clear() + push_back()
+
+    HaplotypeChunks b(a);
+    unit_assert(b.shared());
+    b.clear();
+    unit_assert(b.empty() && !b.shared());
+    b.push_back(HaplotypeChunk(0, 999));
+    unit_assert(a_const.size() == 10 && a_const[0].id == 100);
+    unit_assert(b.size() == 1 && b[0].id == 999);
+
+    // shrinking resize() + growing resize() within capacity
+
+    HaplotypeChunks c(a);
+    c.resize(1);
+    c.resize(5);
+    unit_assert(a_const[1] == HaplotypeChunk(1000, 101));
+    unit_assert(c[1] == HaplotypeChunk());
+
+    // reserve() + writes within capacity
+
+    HaplotypeChunks d;
+    d.share(a);
+    d.reserve(4);
+    unit_assert(!d.shared());
+    d.begin()->id = 666;
+    unit_assert(a_const[0].id == 100);
+
+    // recombine into a buffer shared with a source
+
+    HaplotypeChunks e;
+    for (unsigned int i=0; i<5; i++)
+        e.push_back(HaplotypeChunk(i*2000, 200+i));
+
+    const Chromosome x(a_const), y(e);
+    HaplotypeChunks result;
+    result.share(x.haplotype_chunks());
+    vector<unsigned int> positions(1, 5500);
+    Chromosome::recombine(x, y, positions, result);
+
+    unit_assert(equal(a_copy.begin(), a_copy.end(), x.haplotype_chunks().begin()));
+    unit_assert(equal(a_copy.begin(), a_copy.end(), a_const.begin()));
+    unit_assert(result.size() == 6 + 3);
+    unit_assert(result[0] == HaplotypeChunk(0, 100));
+    unit_assert(result[6] == HaplotypeChunk(5500, 202));
+
+    if (os_) *os_ << endl;
+}
+
+
+void test_HaplotypeChunkArena()
+{
+    if (os_) *os_ << "test_HaplotypeChunkArena()\n";
+
+    HaplotypeChunks source;
+    for (unsigned int i=0; i<5; i++)
+        source.push_back(HaplotypeChunk(i*1000, i));
+
+    HaplotypeChunkArena arena(8);
+    unit_assert(arena.block_count() == 1);
+    unit_assert(arena.capacity() == 8);
+
+    HaplotypeChunks a;
+    a.assign(source.begin(), source.end(), arena);
+    unit_assert(a.uses_arena());
+    unit_assert(a.size() == 5);
+    unit_assert(arena.size() == 5);
+    unit_assert(equal(a.begin(), a.end(), source.begin()));
+
+    // copy of an arena view is owned
+
+    HaplotypeChunks b(a);
+    unit_assert(!b.uses_arena());
+    unit_assert(equal(a.begin(), a.end(), b.begin()));
+
+    // arena adds a block when full
+
+    HaplotypeChunks c;
+    c.assign(source.begin(), source.end(), arena);
+    unit_assert(arena.block_count() == 2);
+    unit_assert(arena.size() == 10);
+    unit_assert(a[4] == HaplotypeChunk(4000, 4)); // earlier views still valid
+
+    // growing an arena view migrates to the heap
+
+    c.push_back(HaplotypeChunk(5000, 5));
+    unit_assert(!c.uses_arena());
+    unit_assert(c.size() == 6);
+    unit_assert(c[4] == HaplotypeChunk(4000, 4));
+
+    // reset coalesces blocks, so the next generation fits in one block
+
+    size_t capacity = arena.capacity();
+    arena.reset();
+    unit_assert(arena.size() == 0);
+    unit_assert(arena.block_count() == 1);
+    unit_assert(arena.capacity() == capacity);
+
+    HaplotypeChunks d, e;
+    d.assign(source.begin(), source.end(), arena);
+    e.assign(source.begin(), source.end(), arena);
+    unit_assert(arena.block_count() == 1);
+
+    // Chromosome copy is owned
+
+    Chromosome chromosome;
+    chromosome.haplotype_chunks().assign(source.begin(), source.end(), arena);
+    Chromosome copy = chromosome;
+    unit_assert(!copy.haplotype_chunks().uses_arena());
+    unit_assert(copy == chromosome);
+
+    if (os_) *os_ << endl;
+}
+
+
 void test()
 {
     test_HaplotypeChunk();
     test_HaplotypeChunk_write_read();
+    test_HaplotypeChunks();
+    test_HaplotypeChunks_inline();
+    test_HaplotypeChunks_shared();
+    test_HaplotypeChunks_shared_mutation();
+    test_HaplotypeChunkArena();
     test_id();
     test_id_write_read();
     test_construction();
@@ -671,6 +1104,8 @@ void test()
     test_recombine_2();
     test_recombine_3();
     test_recombine_4();
+    test_recombine_canonical();
+    test_recombine_random();
     test_write_read_binary();
     test_find_haplotype_chunk();
 }
@@ -35,9 +35,13 @@
 
 #include "Genotype.hpp"
 #include "VariantIndicator.hpp"
+#include "HaplotypeChunkIndex.hpp"
 #include "boost/lexical_cast.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
 #include <iostream>
-#include <numeric>
+#include <algorithm>
+#include <sstream>
 #include <stdexcept>
 
 
@@ -49,20 +53,320 @@ using namespace std;
 //
 
 
+namespace {
+
+
+inline size_t popcount(boost::uint64_t word)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(word);
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ull);
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (word * 0x0101010101010101ull) >> 56;
+#endif
+}
+
+
+} // namespace
+
+
+void GenotypeData::push_back(char genotype)
+{
+    if (packed()) unpack();
+    chars_.push_back(genotype);
+    ++size_;
+}
+
+
+void GenotypeData::resize(size_t n)
+{
+    if (packed()) unpack();
+    chars_.resize(n);
+    size_ = n;
+}
+
+
+void GenotypeData::set(size_t i, char genotype)
+{
+    if (packed()) unpack();
+    chars_[i] = genotype;
+}
+
+
+bool GenotypeData::pack(const GenotypeWordsPtr& words, size_t offset)
+{
+    if (packed()) return true;
+
+    const size_t count = word_count(size_);
+
+    if (!words.get() || words->size() < offset + 2*count)
+        throw runtime_error("[GenotypeData::pack()] Word buffer too small.");
+
+    // raw pointers: this runs over every genotype of every locus
+
+    const char* chars = chars_.empty() ? 0 : &chars_[0];
+
+    char alleles = 0;
+    for (size_t i=0; i<size_; ++i)
+        alleles |= chars[i];
+    if (alleles & ~0x11) return false;
+
+    boost::uint64_t* plane_0 = &(*words)[offset];
+    boost::uint64_t* plane_1 = plane_0 + count;
+
+    for (size_t w=0; w<count; ++w, chars+=64)
+    {
+        boost::uint64_t bits_0 = 0, bits_1 = 0;
+        const size_t bit_count = (w+1 < count || size_%64 == 0) ? 64 : size_%64;
+
+        for (size_t i=0; i<bit_count; ++i)
+        {
+            bits_0 |= boost::uint64_t(chars[i] >> 4) << i;
+            bits_1 |= boost::uint64_t(chars[i] & 1) << i;
+        }
+
+        plane_0[w] = bits_0;
+        plane_1[w] = bits_1;
+    }
+
+    words_ = words;
+    offset_ = offset;
+    vector<char>().swap(chars_);
+    return true;
+}
+
+
+void GenotypeData::attach(const GenotypeWordsPtr& words, size_t offset, size_t size)
+{
+    if (!words.get() || words->size() < offset + 2*word_count(size))
+        throw runtime_error("[GenotypeData::attach()] Word buffer too small.");
+
+    vector<char>().swap(chars_);
+    words_ = words;
+    size_ = size;
+    offset_ = offset;
+}
+
+
+void GenotypeData::unpack()
+{
+    vector<char> chars(size_);
+    for (size_t i=0; i<size_; ++i)
+        chars[i] = (*this)[i];
+
+    chars_.swap(chars);
+    words_.reset();
+    offset_ = 0;
+}
+
+
+char GenotypeData::at(size_t i) const
+{
+    if (i >= size_)
+        throw out_of_range("[GenotypeData::at()] Index out of range.");
+    return (*this)[i];
+}
+
+
+bool GenotypeData::operator==(const GenotypeData& that) const
+{
+    if (size_ != that.size_) return false;
+
+    if (packed() && that.packed())
+    {
+        const size_t count = 2*word_count(size_);
+        return equal(plane(0), plane(0) + count, that.plane(0));
+    }
+
+    if (!packed() && !that.packed())
+        return chars_ == that.chars_;
+
+    for (size_t i=0; i<size_; ++i)
+        if ((*this)[i] != that[i]) return false;
+
+    return true;
+}
+
+
+size_t GenotypeData::allele_count() const
+{
+    size_t result = 0;
+
+    if (packed())
+    {
+        const boost::uint64_t* words = plane(0);
+        const size_t count = 2*word_count(size_);
+        for (size_t w=0; w<count; ++w)
+            result += popcount(words[w]);
+    }
+    else
+    {
+        for (vector<char>::const_iterator it=chars_.begin(); it!=chars_.end(); ++it)
+            result += size_t(genotype_sum(*it));
+    }
+
+    return result;
+}
+
+
+size_t GenotypeData::joint_allele_count(const GenotypeData& that) const
+{
+    if (size_ != that.size_)
+        throw runtime_error("[GenotypeData::joint_allele_count()] Size mismatch.");
+
+    size_t result = 0;
+
+    if (packed() && that.packed())
+    {
+        const boost::uint64_t* a = plane(0);
+        const boost::uint64_t* b = that.plane(0);
+        const size_t count = 2*word_count(size_);
+        for (size_t w=0; w<count; ++w)
+            result += popcount(a[w] & b[w]);
+    }
+    else
+    {
+        for (size_t i=0; i<size_; ++i)
+        {
+            const char g = (*this)[i], h = that[i];
+            result += size_t(genotype_first(g) * genotype_first(h) + genotype_second(g) * genotype_second(h));
+        }
+    }
+
+    return result;
+}
+
+
 double GenotypeData::allele_frequency() const
 {
-    vector<char> sums(size());
-    transform(begin(), end(), sums.begin(), genotype_sum);
-    double sum = accumulate(sums.begin(), sums.end(), 0.0);
+    double sum = double(allele_count());
     return sum/size()/2;
 }
 
 
+//
+// GenotypeMap
+//
+
+
+GenotypeDataPtr GenotypeMap::get(const Locus& locus) const
+{
+    const_iterator it = find(locus);
+
+    if (it == end() && deferred_.count(locus))
+    {
+        // genotype the deferred loci on this chromosome pair (memoization: 
+        // the map is logically const)
+
+        Loci loci;
+        for (Loci::iterator jt=deferred_.begin(); jt!=deferred_.end();)
+        {
+            if (jt->chromosome_pair_index == locus.chromosome_pair_index)
+            {
+                loci.insert(*jt);
+                deferred_.erase(jt++);
+            }
+            else
+                ++jt;
+        }
+
+        genotyper_->genotype(loci, *population_, *indicator_, const_cast<GenotypeMap&>(*this));
+        computed_count_ += loci.size();
+        it = find(locus);
+    }
+
+    if (it == end())
+    {
+        std::ostringstream message;
+        message <<  "[GenotypeMap] Locus " << locus << " not found.";
+        throw std::runtime_error(message.str().c_str());
+    }
+
+    if (!it->second.get())
+    {
+        std::ostringstream message;
+        message <<  "[GenotypeMap] Null data at locus " << locus;
+        throw std::runtime_error(message.str().c_str());
+    }
+
+    return it->second;
+}
+
+
+bool GenotypeMap::contains(const Locus& locus) const
+{
+    return count(locus) || deferred_.count(locus);
+}
+
+
+void GenotypeMap::set(const Locus& locus, const GenotypeDataPtr& genotypes)
+{
+    (*this)[locus] = genotypes;
+    deferred_.erase(locus);
+}
+
+
+void GenotypeMap::clear()
+{
+    std::map<Locus, GenotypeDataPtr>::clear();
+    end_deferral();
+}
+
+
+void GenotypeMap::defer(const Loci& loci, 
+                        const Population& population,
+                        const VariantIndicator& indicator,
+                        const Genotyper& genotyper)
+{
+    if (!deferred_.empty() && (&population != population_ || &indicator != indicator_ || &genotyper != genotyper_))
+        throw runtime_error("[GenotypeMap::defer()] Loci already deferred with a different source.");
+
+    for (Loci::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+    {
+        if (count(*locus) || deferred_.count(*locus)) continue;
+        deferred_.insert(*locus);
+        ++deferred_count_;
+    }
+
+    population_ = &population;
+    indicator_ = &indicator;
+    genotyper_ = &genotyper;
+}
+
+
+Loci GenotypeMap::loci() const
+{
+    Loci result(deferred_);
+    for (const_iterator it=begin(); it!=end(); ++it)
+        result.insert(it->first);
+    return result;
+}
+
+
+void GenotypeMap::end_deferral()
+{
+    deferred_.clear();
+    population_ = 0;
+    indicator_ = 0;
+    genotyper_ = 0;
+}
+
+
 //
 // Genotyper
 //
 
 
+Genotyper::Genotyper(Method method, size_t thread_count)
+:   method_(method), thread_count_(thread_count)
+{
+    if (thread_count_ == 0)
+        throw runtime_error("[Genotyper] Thread count must be positive.");
+}
+
+
 char Genotyper::genotype(const Locus& locus, 
                          const Organism& organism,
                          const VariantIndicator& indicator) const
@@ -89,22 +393,391 @@ char Genotyper::genotype(const Locus& locus,
 }
 
 
+namespace {
+
+
+// write_planes: packs the allele values of count organisms (two values per
+// organism) into whole words from plane_0[0] and plane_1[0];  returns false if
+// any value is not 0/1, in which case the planes are not valid
+
+bool write_planes(const unsigned int* values, size_t count, 
+                  boost::uint64_t* plane_0, boost::uint64_t* plane_1)
+{
+    unsigned int alleles = 0;
+
+    for (size_t w=0; w*64<count; ++w)
+    {
+        const unsigned int* v = values + 128*w;
+        const size_t bit_count = min(size_t(64), count - w*64);
+        boost::uint64_t bits_0 = 0, bits_1 = 0;
+
+        for (size_t i=0; i<bit_count; ++i)
+        {
+            alleles |= v[2*i] | v[2*i+1];
+            bits_0 |= boost::uint64_t(v[2*i] & 1) << i;
+            bits_1 |= boost::uint64_t(v[2*i+1] & 1) << i;
+        }
+
+        plane_0[w] = bits_0;
+        plane_1[w] = bits_1;
+    }
+
+    return (alleles & ~1u) == 0;
+}
+
+
+// LocusColumns: a GenotypeData column for each locus, allocated for the whole
+// population, with loci grouped by chromosome pair (Loci are sorted by 
+// (chromosome pair, position)).  Given a word buffer, the columns are packed
+// and attached to consecutive slices of it (planes[i] is the first plane of
+// column i);  otherwise they are chars.
+
+struct LocusColumns
+{
+    std::vector<const Locus*> loci;
+    std::vector<GenotypeData*> columns;
+    std::vector<size_t> pair_begin; // index of first locus of each pair, size chromosome_pair_count+1
+    std::vector<boost::uint64_t*> planes;
+    size_t word_count; // per plane
+
+    LocusColumns(const Loci& loci_in, size_t chromosome_pair_count, size_t population_size,
+                 GenotypeMap& genotype_map, const char* caller, 
+                 const GenotypeWordsPtr& words = GenotypeWordsPtr())
+    :   word_count(GenotypeData::word_count(population_size))
+    {
+        pair_begin.push_back(0);
+
+        for (Loci::const_iterator locus=loci_in.begin(); locus!=loci_in.end(); ++locus)
+        {
+            if (locus->chromosome_pair_index >= chromosome_pair_count)
+                throw runtime_error((string("[") + caller + "] chromosome_pair_index out of range.").c_str());
+
+            while (pair_begin.size() <= locus->chromosome_pair_index)
+                pair_begin.push_back(loci.size());
+
+            GenotypeDataPtr genotypes(new GenotypeData);
+            genotype_map.set(*locus, genotypes);
+
+            if (words.get())
+            {
+                const size_t offset = 2*word_count*loci.size();
+                genotypes->attach(words, offset, population_size);
+                planes.push_back(&(*words)[offset]);
+            }
+            else
+            {
+                genotypes->resize(population_size);
+            }
+
+            loci.push_back(&*locus);
+            columns.push_back(genotypes.get());
+        }
+
+        while (pair_begin.size() <= chromosome_pair_count)
+            pair_begin.push_back(loci.size());
+    }
+};
+
+
+// Sweep: genotypes organisms [begin, end) of a Population into packed columns;
+// begin is a multiple of 64, so workers write disjoint words of the planes.  
+// Organisms are processed in blocks:  the merge join fills a table of chunk ids
+// (one row per locus), and each row is passed to the VariantIndicator in a 
+// single lookup() call.  Columns with alleles other than 0/1 are flagged in 
+// multiallelic, for the caller to genotype as chars.
+
+class Sweep
+{
+    public:
+
+    Sweep(const Population& population, const VariantIndicator& indicator, const LocusColumns& columns)
+    :   population_(population), indicator_(indicator), columns_(columns)
+    {}
+
+    void operator()(size_t begin, size_t end, vector<char>& multiallelic) const
+    {
+        const size_t block_size_max = 128; // multiple of 64
+        vector<unsigned int> ids;
+        vector<unsigned int> values(2*block_size_max);
+
+        for (size_t block_begin=begin; block_begin<end; block_begin+=block_size_max)
+        {
+            const size_t block_size = min(block_size_max, end - block_begin);
+            const size_t row_size = 2*block_size;
+
+            for (size_t pair=0; pair<population_.chromosome_pair_count(); ++pair)
+            {
+                const size_t locus_begin = columns_.pair_begin[pair];
+                const size_t locus_end = columns_.pair_begin[pair+1];
+                if (locus_begin == locus_end) continue;
+
+                ids.resize((locus_end - locus_begin) * row_size);
+
+                for (size_t k=0; k<block_size; ++k)
+                {
+                    const ChromosomePair& cp = population_.chromosome_pair_range(block_begin + k).begin()[pair];
+                    sweep(cp.first.haplotype_chunks(), locus_begin, locus_end, &ids[2*k], row_size);
+                    sweep(cp.second.haplotype_chunks(), locus_begin, locus_end, &ids[2*k+1], row_size);
+                }
+
+                for (size_t i=locus_begin; i<locus_end; ++i)
+                {
+                    indicator_.lookup(*columns_.loci[i], &ids[(i-locus_begin)*row_size], row_size, &values[0]);
+
+                    boost::uint64_t* plane_0 = columns_.planes[i] + block_begin/64;
+                    if (!write_planes(&values[0], block_size, plane_0, plane_0 + columns_.word_count))
+                        multiallelic[i] = 1;
+                }
+            }
+        }
+    }
+
+    private:
+
+    const Population& population_;
+    const VariantIndicator& indicator_;
+    const LocusColumns& columns_;
+
+    void sweep(const HaplotypeChunks& chunks, size_t locus_begin, size_t locus_end, 
+               unsigned int* ids, size_t stride) const
+    {
+        // merge join: chunk is the last chunk starting at or before the locus (as find_haplotype_chunk())
+
+        const HaplotypeChunk* chunk = chunks.begin();
+        const HaplotypeChunk* const chunk_last = chunks.end() - 1;
+
+        for (size_t i=locus_begin; i<locus_end; ++i, ids+=stride)
+        {
+            const unsigned int position = columns_.loci[i]->position;
+            while (chunk != chunk_last && (chunk+1)->position <= position) ++chunk;
+            *ids = chunk->id;
+        }
+    }
+};
+
+
+class SweepWorker
+{
+    public:
+
+    SweepWorker(const Sweep& sweep, size_t begin, size_t end, vector<char>& multiallelic,
+                string& error, boost::mutex& error_mutex)
+    :   sweep_(sweep), begin_(begin), end_(end), multiallelic_(multiallelic), 
+        error_(error), error_mutex_(error_mutex)
+    {}
+
+    void operator()() const
+    {
+        try
+        {
+            sweep_(begin_, end_, multiallelic_);
+        }
+        catch (exception& e)
+        {
+            boost::mutex::scoped_lock lock(error_mutex_);
+            error_ = e.what();
+        }
+    }
+
+    private:
+
+    const Sweep& sweep_;
+    size_t begin_;
+    size_t end_;
+    vector<char>& multiallelic_;
+    string& error_;
+    boost::mutex& error_mutex_;
+};
+
+
+} // namespace
+
+
 void Genotyper::genotype(const Loci& loci, 
                          const Population& population,
                          const VariantIndicator& indicator,
                          GenotypeMap& genotype_map) const
 {
-    for (Loci::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+    // sweep reads every chunk of the chromosomes it visits, as does building the
+    // HaplotypeChunkIndex used by search for several loci on a chromosome pair; with
+    // fewer loci per pair, search touches only the chunks it needs
+
+    const size_t sweep_loci_per_pair_min = 4;
+
+    Method method = method_;
+
+    if (method == Method_Auto)
     {
-        GenotypeDataPtr genotypes(new GenotypeData);
-        genotypes->reserve(population.population_size());
+        size_t pair_count = 0;
+        size_t pair_previous = 0;
+        for (Loci::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+        {
+            if (pair_count == 0 || locus->chromosome_pair_index != pair_previous) ++pair_count;
+            pair_previous = locus->chromosome_pair_index;
+        }
+
+        method = (loci.size() >= sweep_loci_per_pair_min * pair_count && !loci.empty()) ? Method_Sweep : Method_Search;
+    }
+
+    if (method == Method_Sweep)
+        genotype_sweep(loci, population, indicator, genotype_map);
+    else
+        genotype_search(loci, population, indicator, genotype_map);
+}
+
+
+GenotypeWordsPtr Genotyper::allocate_words(size_t word_count) const
+{
+    const size_t pool_size_max = 4;
+
+    for (vector<GenotypeWordsPtr>::const_iterator it=words_pool_.begin(); it!=words_pool_.end(); ++it)
+    {
+        if (it->use_count() == 1) // held only by the pool
+        {
+            (*it)->resize(word_count);
+            return *it;
+        }
+    }
+
+    GenotypeWordsPtr result(new GenotypeWords(word_count));
+    if (words_pool_.size() < pool_size_max) words_pool_.push_back(result);
+    return result;
+}
+
+
+void Genotyper::genotype_sweep(const Loci& loci, 
+                               const Population& population,
+                               const VariantIndicator& indicator,
+                               GenotypeMap& genotype_map) const
+{
+    const size_t population_size = population.population_size();
+
+    GenotypeWordsPtr words = population_size ? 
+        allocate_words(2*GenotypeData::word_count(population_size) * loci.size()) : GenotypeWordsPtr();
 
-        const ChromosomePairRangeIterator range_end = population.end();
-        for (const ChromosomePairRangeIterator range=population.begin(); range!=range_end; ++range)
-            genotypes->push_back(genotype(*locus, *range, indicator));
+    LocusColumns columns(loci, population.chromosome_pair_count(), population_size, 
+                         genotype_map, "Genotyper::genotype(Population)", words);
 
-        genotype_map[*locus] = genotypes;
+    if (population_size == 0) return;
+
+    Sweep sweep(population, indicator, columns);
+
+    const size_t thread_count = min(thread_count_, GenotypeData::word_count(population_size));
+    vector< vector<char> > multiallelic(thread_count, vector<char>(loci.size()));
+
+    if (thread_count == 1)
+    {
+        sweep(0, population_size, multiallelic[0]);
     }
+    else
+    {
+        string error;
+        boost::mutex error_mutex;
+        boost::thread_group workers;
+
+        for (size_t t=0; t<thread_count; ++t)
+        {
+            // worker boundaries are word boundaries
+            const size_t begin = population_size * t / thread_count / 64 * 64;
+            const size_t end = t+1 < thread_count ? population_size * (t+1) / thread_count / 64 * 64 : population_size;
+            workers.create_thread(SweepWorker(sweep, begin, end, multiallelic[t], error, error_mutex));
+        }
+
+        workers.join_all();
+
+        if (!error.empty())
+            throw runtime_error(error.c_str());
+    }
+
+    // loci with alleles other than 0/1 are genotyped again, as chars
+
+    Loci loci_multiallelic;
+    for (size_t i=0; i<loci.size(); ++i)
+    for (size_t t=0; t<thread_count; ++t)
+    {
+        if (!multiallelic[t][i]) continue;
+        loci_multiallelic.insert(*columns.loci[i]);
+        break;
+    }
+
+    if (!loci_multiallelic.empty())
+        genotype_search(loci_multiallelic, population, indicator, genotype_map);
 }
 
 
+void Genotyper::genotype_search(const Loci& loci, 
+                                const Population& population,
+                                const VariantIndicator& indicator,
+                                GenotypeMap& genotype_map) const
+{
+    // Loci are sorted by chromosome pair: when a chromosome pair has several 
+    // loci, the chromosomes are copied once into a HaplotypeChunkIndex so that
+    // each lookup is a SIMD breakpoint search over contiguous positions.
+
+    // Genotypes are written as bit planes into slices of a single word buffer, 
+    // or as chars for loci with alleles other than 0/1.
+
+    const size_t index_locus_count_min = 4;
+    HaplotypeChunkIndex index;
+    bool index_valid = false;
+    vector<unsigned int> ids;    // chunk ids of all chromosomes at the current locus
+    vector<unsigned int> values;
+
+    const size_t population_size = population.population_size();
+    const size_t stride = 2*GenotypeData::word_count(population_size);
+    GenotypeWordsPtr words = population_size ? allocate_words(stride * loci.size()) : GenotypeWordsPtr();
+    size_t offset = 0;
+
+    for (Loci::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus, offset+=stride)
+    {
+        GenotypeDataPtr genotypes(new GenotypeData);
+
+        if (!index_valid || index.chromosome_pair_index() != locus->chromosome_pair_index)
+        {
+            size_t locus_count = 0;
+            for (Loci::const_iterator it=locus; it!=loci.end() && locus_count<index_locus_count_min && 
+                 it->chromosome_pair_index==locus->chromosome_pair_index; ++it)
+                ++locus_count;
+
+            index_valid = (locus_count >= index_locus_count_min);
+            if (index_valid) index.build(population, locus->chromosome_pair_index);
+        }
+
+        ids.clear();
+
+        if (index_valid)
+        {
+            for (size_t i=0; i<index.chromosome_count(); ++i)
+                ids.push_back(index.find_id(i, locus->position));
+        }
+        else
+        {
+            const ChromosomePairRangeIterator range_end = population.end();
+            for (const ChromosomePairRangeIterator range=population.begin(); range!=range_end; ++range)
+            {
+                if (locus->chromosome_pair_index >= range->size())
+                    throw runtime_error("[Genotyper::genotype(ChromosomePairRange) chromosome_pair_index out of range.");
+                const ChromosomePair& cp = range->begin()[locus->chromosome_pair_index];
+                ids.push_back(cp.first.find_haplotype_chunk(locus->position)->id);
+                ids.push_back(cp.second.find_haplotype_chunk(locus->position)->id);
+            }
+        }
+
+        values.resize(ids.size());
+        if (!ids.empty())
+            indicator.lookup(*locus, &ids[0], ids.size(), &values[0]);
+
+        if (words.get() && write_planes(&values[0], population_size, &(*words)[offset], &(*words)[offset] + stride/2))
+        {
+            genotypes->attach(words, offset, population_size);
+        }
+        else
+        {
+            genotypes->reserve(population_size);
+            for (size_t i=0; i<values.size(); i+=2)
+                genotypes->push_back(genotype_make_pair(char(values[i]), char(values[i+1])));
+        }
+
+        genotype_map.set(*locus, genotypes);
+    }
+}
@@ -40,12 +40,15 @@
 #include "Locus.hpp"
 #include "Configurable.hpp"
 #include "shared_ptr.hpp"
+#include "boost/cstdint.hpp"
 #include <vector>
 #include <map>
 #include <set>
+#include <iterator>
 
 
 class ChromosomePairRange;
+class Genotyper;
 class Organism;
 class Population;
 class VariantIndicator;
@@ -83,48 +86,155 @@ inline char genotype_second(char genotype)
 }
 
 
-class GenotypeData : public std::vector<char>
+//
+// GenotypeData: genotypes of all individuals in a population at a single locus
+//
+// Data is built up as chars (push_back(), resize(), set()), and may then be
+// packed into two bit planes (allele 0 and allele 1 of each individual) if all
+// alleles are 0/1;  the planes live in a GenotypeWords buffer that may be shared
+// by the columns of many loci.  The Genotyper writes planes directly and 
+// attaches them, using chars only for loci with other alleles.  Packed data 
+// reads the same as char data, with counts computed by popcount.  Mutating 
+// packed data unpacks it first.
+//
+
+
+typedef std::vector<boost::uint64_t> GenotypeWords;
+typedef shared_ptr<GenotypeWords> GenotypeWordsPtr;
+
+
+class GenotypeData
 {
     public:
 
-    GenotypeData() {}
-    GenotypeData(const char* begin, const char* end) : std::vector<char>(begin, end) {}
+    GenotypeData() : size_(0), offset_(0) {}
+    GenotypeData(const char* begin, const char* end) : chars_(begin, end), size_(end - begin), offset_(0) {}
+
+    // building
+
+    void push_back(char genotype);
+    void reserve(size_t n) {if (!packed()) chars_.reserve(n);}
+    void resize(size_t n);
+    void set(size_t i, char genotype);
+
+    // packs into words[offset, offset + 2*word_count(size())) if all alleles are 0/1;
+    // returns packed()
+    bool pack(const GenotypeWordsPtr& words, size_t offset);
+    static size_t word_count(size_t size) {return (size + 63)/64;}
+
+    // replaces the data with size genotypes packed by the caller into 
+    // words[offset, offset + 2*word_count(size)), unused bits 0
+    void attach(const GenotypeWordsPtr& words, size_t offset, size_t size);
+
+    // reading
+
+    size_t size() const {return size_;}
+    bool empty() const {return size_ == 0;}
 
+    char operator[](size_t i) const
+    {
+        if (!packed()) return chars_[i];
+        const boost::uint64_t* plane_0 = &(*words_)[offset_];
+        const boost::uint64_t* plane_1 = plane_0 + word_count(size_);
+        return genotype_make_pair(char((plane_0[i/64] >> (i%64)) & 1), char((plane_1[i/64] >> (i%64)) & 1));
+    }
+
+    char at(size_t i) const; // throws if out of range
+
+    class const_iterator : public std::iterator<std::forward_iterator_tag, char, std::ptrdiff_t, const char*, char>
+    {
+        public:
+        const_iterator(const GenotypeData* data = 0, size_t index = 0) : data_(data), index_(index) {}
+        char operator*() const {return (*data_)[index_];}
+        const_iterator& operator++() {++index_; return *this;}
+        const_iterator operator++(int) {const_iterator result(*this); ++index_; return result;}
+        bool operator==(const const_iterator& that) const {return index_ == that.index_ && data_ == that.data_;}
+        bool operator!=(const const_iterator& that) const {return !(*this == that);}
+        private:
+        const GenotypeData* data_;
+        size_t index_;
+    };
+
+    const_iterator begin() const {return const_iterator(this, 0);}
+    const_iterator end() const {return const_iterator(this, size_);}
+
+    bool operator==(const GenotypeData& that) const;
+    bool operator!=(const GenotypeData& that) const {return !(*this == that);}
+
+    // bit planes (packed data only): plane(which)[0, word_count(size())), unused bits 0
+
+    bool packed() const {return words_.get() != 0;}
+    const boost::uint64_t* plane(size_t which) const {return &(*words_)[offset_ + which*word_count(size_)];}
+
+    // counts (assume binary alleles (0/1 valued))
+
+    size_t allele_count() const; // sum of alleles over all individuals
+    size_t joint_allele_count(const GenotypeData& that) const; // sum of allele products, haplotype by haplotype
     double allele_frequency() const; // note: assumes binary alleles (0/1 valued)
 
     // when needed: multiple allele case
     //  vector<double> multiple_allele_frequencies() const; 
     //  assume alleles are encoded as {0, ..., n-1}, return vector size n
+
+    private:
+
+    std::vector<char> chars_;  // char data, empty if packed
+    GenotypeWordsPtr words_;   // packed data, null if not packed
+    size_t size_;
+    size_t offset_;
+
+    void unpack();
 };
 
 
 typedef shared_ptr<GenotypeData> GenotypeDataPtr;
 
 
-class GenotypeMap : public std::map<Locus, GenotypeDataPtr> // map locus -> trait_values
+//
+// GenotypeMap
+//
+// Loci may be deferred:  a deferred locus is genotyped on its first get(),
+// together with the other deferred loci on the same chromosome pair, and the
+// result is memoized.  The Population, VariantIndicator, and Genotyper must
+// outlive the deferral (see end_deferral()).
+//
+
+
+class GenotypeMap : private std::map<Locus, GenotypeDataPtr> // map locus -> genotypes
 {
     public:
 
-    GenotypeDataPtr get(const Locus& locus) const // returns valid pointer, or throws
-    {
-        if (!count(locus))
-        {
-            std::ostringstream message;
-            message <<  "[GenotypeMap] Locus " << locus << " not found.";
-            throw std::runtime_error(message.str().c_str());
-        }
-
-        GenotypeDataPtr result = at(locus);
-    
-        if (!result.get())
-        {
-            std::ostringstream message;
-            message <<  "[GenotypeMap] Null data at locus " << locus;
-            throw std::runtime_error(message.str().c_str());
-        }
-
-        return at(locus);
-    }
+    GenotypeMap() : population_(0), indicator_(0), genotyper_(0), deferred_count_(0), computed_count_(0) {}
+
+    GenotypeDataPtr get(const Locus& locus) const; // returns valid pointer, or throws
+    bool contains(const Locus& locus) const; // genotyped or deferred
+
+    void set(const Locus& locus, const GenotypeDataPtr& genotypes); // replaces any deferral
+    void clear(); // drops genotypes and deferred loci
+
+    // lazy genotyping
+
+    void defer(const Loci& loci, 
+               const Population& population,
+               const VariantIndicator& indicator,
+               const Genotyper& genotyper);
+
+    void end_deferral(); // drops loci not yet genotyped
+
+    Loci loci() const; // genotyped and deferred loci
+
+    size_t genotyped_count() const {return size();} // loci with genotypes (excludes deferred)
+    size_t deferred_count() const {return deferred_count_;} // loci deferred
+    size_t computed_count() const {return computed_count_;} // deferred loci genotyped on get()
+
+    private:
+
+    mutable Loci deferred_;
+    const Population* population_;
+    const VariantIndicator* indicator_;
+    const Genotyper* genotyper_;
+    size_t deferred_count_;
+    mutable size_t computed_count_;
 };
 
 
@@ -140,6 +250,20 @@ class Genotyper
 {
     public:
 
+    // method for genotyping a Population at multiple loci (all give the same result):
+    //   - search: for each locus, a search in each chromosome's chunks (through a
+    //     HaplotypeChunkIndex when the chromosome pair has several loci)
+    //   - sweep: each chromosome's chunks are walked once, in position order, 
+    //     against the sorted loci on it, O(chunks + loci) per chromosome; 
+    //     organisms are divided among thread_count threads
+    //   - auto: sweep when there are several loci per chromosome pair
+    enum Method {Method_Auto, Method_Search, Method_Sweep};
+
+    Genotyper(Method method = Method_Auto, size_t thread_count = 1);
+
+    Method method() const {return method_;}
+    size_t thread_count() const {return thread_count_;}
+
     // returns genotype for a single organism at a single locus
     char genotype(const Locus& locus, 
                   const Organism& organism,
@@ -155,6 +279,27 @@ class Genotyper
                   const Population& population,
                   const VariantIndicator& indicator,
                   GenotypeMap& genotype_map) const;
+
+    private:
+
+    Method method_;
+    size_t thread_count_;
+
+    // word buffers for packed GenotypeData (one per genotype() call, shared by
+    // all loci), reused by later calls once no GenotypeData refers to them
+    mutable std::vector<GenotypeWordsPtr> words_pool_;
+
+    GenotypeWordsPtr allocate_words(size_t word_count) const;
+
+    void genotype_search(const Loci& loci, 
+                         const Population& population,
+                         const VariantIndicator& indicator,
+                         GenotypeMap& genotype_map) const;
+
+    void genotype_sweep(const Loci& loci, 
+                        const Population& population,
+                        const VariantIndicator& indicator,
+                        GenotypeMap& genotype_map) const;
 };
 
 
@@ -39,6 +39,7 @@
 #include "unit.hpp"
 #include <iostream>
 #include <iterator>
+#include <algorithm>
 #include <cstring>
 
 
@@ -188,7 +189,7 @@ void test_genotype_harder()
     GenotypeMap genotype_map;
     genotyper.genotype(loci, population, indicator, genotype_map);
 
-    GenotypeDataPtr genotypes = genotype_map.at(locus);
+    GenotypeDataPtr genotypes = genotype_map.get(locus);
     
     if (os_)
     {
@@ -205,6 +206,219 @@ void test_genotype_harder()
 }
 
 
+void test_genotype_multiple_loci()
+{
+    if (os_) *os_ << "test_genotype_multiple_loci()\n";
+
+    // many loci on one chromosome pair exercise the HaplotypeChunkIndex path
+
+    Organisms organisms;
+
+    for (unsigned int n=0; n<7; ++n)
+    {
+        Organism::Gamete gametes[2];
+
+        for (unsigned int which=0; which<2; ++which)
+        {
+            HaplotypeChunks chunks;
+            for (unsigned int i=0; i<=n+which; ++i)
+                chunks.push_back(HaplotypeChunk(i*100000, (n+i+which)%2));
+            gametes[which].push_back(Chromosome(chunks));
+        }
+
+        organisms.push_back(Organism(gametes[0], gametes[1]));
+    }
+
+    Population_Organisms population(organisms);
+
+    Loci loci;
+    for (unsigned int position=0; position<1000000; position+=50000)
+        loci.insert(Locus("", 0, position));
+
+    VariantIndicator_Test indicator;
+    Genotyper genotyper;
+    GenotypeMap genotype_map;
+    genotyper.genotype(loci, population, indicator, genotype_map);
+
+    unit_assert(genotype_map.genotyped_count() == loci.size());
+
+    for (Loci::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+    {
+        GenotypeDataPtr genotypes = genotype_map.get(*locus);
+        unit_assert(genotypes->size() == organisms.size());
+
+        for (size_t n=0; n<organisms.size(); ++n)
+            unit_assert(genotypes->at(n) == genotyper.genotype(*locus, organisms[n], indicator));
+
+        unit_assert(genotypes->packed()); // alleles are 0/1
+    }
+
+    // the word buffer is reused once the previous GenotypeMap is gone
+
+    const boost::uint64_t* plane = genotype_map.get(*loci.begin())->plane(0);
+
+    GenotypeMap genotype_map_2;
+    genotyper.genotype(loci, population, indicator, genotype_map_2);
+    unit_assert(genotype_map_2.get(*loci.begin())->plane(0) != plane);
+
+    genotype_map.clear();
+    GenotypeMap genotype_map_3;
+    genotyper.genotype(loci, population, indicator, genotype_map_3);
+    unit_assert(genotype_map_3.get(*loci.begin())->plane(0) == plane);
+
+    for (Loci::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+        unit_assert(*genotype_map_3.get(*locus) == *genotype_map_2.get(*locus));
+}
+
+
+void test_genotype_methods()
+{
+    if (os_) *os_ << "test_genotype_methods()\n";
+
+    // search and sweep give the same genotypes, for any thread count
+
+    const size_t chromosome_pair_count = 3;
+    Organisms organisms;
+
+    for (unsigned int n=0; n<11; ++n)
+    {
+        Organism::Gamete gametes[2];
+
+        for (unsigned int which=0; which<2; ++which)
+        for (unsigned int pair=0; pair<chromosome_pair_count; ++pair)
+        {
+            HaplotypeChunks chunks;
+            for (unsigned int i=0; i<=(n*7+which*3+pair)%5; ++i)
+                chunks.push_back(HaplotypeChunk(i*(100000 + 1000*n), 10*n + 2*i + which));
+            gametes[which].push_back(Chromosome(chunks));
+        }
+
+        organisms.push_back(Organism(gametes[0], gametes[1]));
+    }
+
+    Population_Organisms population(organisms);
+
+    Loci loci; // none on pair 1;  some at chunk boundaries
+    for (unsigned int position=0; position<1000000; position+=25000)
+    {
+        loci.insert(Locus("", 0, position));
+        loci.insert(Locus("", 2, position + 1000));
+    }
+
+    VariantIndicator_Test indicator;
+    Genotyper genotyper_search(Genotyper::Method_Search);
+
+    GenotypeMap genotype_map_search;
+    genotyper_search.genotype(loci, population, indicator, genotype_map_search);
+
+    const size_t thread_counts[] = {1, 3, 20};
+
+    for (size_t t=0; t<3; ++t)
+    {
+        Genotyper genotyper_sweep(Genotyper::Method_Sweep, thread_counts[t]);
+        Genotyper genotyper_auto(Genotyper::Method_Auto, thread_counts[t]);
+
+        GenotypeMap genotype_map_sweep;
+        genotyper_sweep.genotype(loci, population, indicator, genotype_map_sweep);
+
+        GenotypeMap genotype_map_auto;
+        genotyper_auto.genotype(loci, population, indicator, genotype_map_auto);
+
+        unit_assert(genotype_map_sweep.genotyped_count() == loci.size());
+        unit_assert(genotype_map_auto.genotyped_count() == loci.size());
+
+        for (Loci::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+        {
+            unit_assert(*genotype_map_sweep.get(*locus) == *genotype_map_search.get(*locus));
+            unit_assert(*genotype_map_auto.get(*locus) == *genotype_map_search.get(*locus));
+        }
+    }
+
+    Loci loci_bad;
+    loci_bad.insert(Locus("", chromosome_pair_count, 0));
+    GenotypeMap genotype_map;
+    Genotyper genotyper_sweep(Genotyper::Method_Sweep);
+    unit_assert_throws(genotyper_sweep.genotype(loci_bad, population, indicator, genotype_map), runtime_error);
+    unit_assert_throws(Genotyper(Genotyper::Method_Sweep, 0), runtime_error);
+}
+
+
+class VariantIndicator_Mixed : public VariantIndicator
+{
+    public:
+
+    VariantIndicator_Mixed() : Configurable("variant_indicator_mixed") {}
+
+    // 0/1 alleles on chromosome pair 0, alleles 0/1/2 on pair 1
+    virtual unsigned int operator()(unsigned int chromosome_id, const Locus& locus) const
+    {
+        return locus.chromosome_pair_index == 0 ? chromosome_id%2 : chromosome_id%3;
+    }
+};
+
+
+void test_genotype_planes()
+{
+    if (os_) *os_ << "test_genotype_planes()\n";
+
+    // bit planes are written directly for 0/1 loci, across word boundaries 
+    // between sweep workers;  other loci fall back to chars
+
+    const size_t chromosome_pair_count = 2;
+    Organisms organisms;
+
+    for (unsigned int n=0; n<150; ++n)
+    {
+        Organism::Gamete gametes[2];
+
+        for (unsigned int which=0; which<2; ++which)
+        for (unsigned int pair=0; pair<chromosome_pair_count; ++pair)
+        {
+            HaplotypeChunks chunks;
+            for (unsigned int i=0; i<=(n+which+pair)%4; ++i)
+                chunks.push_back(HaplotypeChunk(i*200000, n*7 + i*3 + which));
+            gametes[which].push_back(Chromosome(chunks));
+        }
+
+        organisms.push_back(Organism(gametes[0], gametes[1]));
+    }
+
+    Population_Organisms population(organisms);
+
+    Loci loci;
+    for (unsigned int position=0; position<1000000; position+=100000)
+    {
+        loci.insert(Locus("", 0, position));
+        loci.insert(Locus("", 1, position + 5000));
+    }
+
+    VariantIndicator_Mixed indicator;
+    Genotyper::Method methods[] = {Genotyper::Method_Search, Genotyper::Method_Sweep};
+    const size_t thread_counts[] = {1, 3};
+
+    for (size_t m=0; m<2; ++m)
+    for (size_t t=0; t<2; ++t)
+    {
+        Genotyper genotyper(methods[m], thread_counts[t]);
+        GenotypeMap genotype_map;
+        genotyper.genotype(loci, population, indicator, genotype_map);
+
+        for (Loci::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+        {
+            GenotypeDataPtr genotypes = genotype_map.get(*locus);
+            unit_assert(genotypes->size() == organisms.size());
+            unit_assert(genotypes->packed() == (locus->chromosome_pair_index == 0));
+
+            for (size_t n=0; n<organisms.size(); ++n)
+                unit_assert(genotypes->at(n) == genotyper.genotype(*locus, organisms[n], indicator));
+
+            if (genotypes->packed())
+                unit_assert(genotypes->plane(1)[2] >> (organisms.size()%64) == 0); // unused bits 0
+        }
+    }
+}
+
+
 void test_allele_frequency()
 {
     GenotypeData data;
@@ -219,13 +433,143 @@ void test_allele_frequency()
 }
 
 
+void test_pack()
+{
+    if (os_) *os_ << "test_pack()\n";
+
+    // 150 individuals: 3 words per plane, the last one partial
+
+    const size_t n = 150;
+    GenotypeData data, data_2;
+    for (size_t i=0; i<n; ++i)
+    {
+        data.push_back(genotype_make_pair(i%3==0, i%5==0));
+        data_2.push_back(genotype_make_pair(i%2==0, i%7==0));
+    }
+
+    const GenotypeData chars = data;
+    const size_t allele_count = data.allele_count();
+    const size_t joint_allele_count = data.joint_allele_count(data_2);
+    unit_assert(allele_count == 50 + 30);
+
+    const size_t stride = 2*GenotypeData::word_count(n);
+    unit_assert(stride == 6);
+    GenotypeWordsPtr words(new GenotypeWords(2*stride, ~boost::uint64_t(0)));
+
+    unit_assert(!data.packed());
+    unit_assert(data.pack(words, 0));
+    unit_assert(data_2.pack(words, stride));
+    unit_assert(data.packed() && data.size() == n);
+    unit_assert(data.plane(0)[2] >> (n%64) == 0); // unused bits 0
+
+    unit_assert(data == chars && chars == data);
+    for (size_t i=0; i<n; ++i)
+        unit_assert(data[i] == chars[i]);
+    unit_assert(equal(data.begin(), data.end(), chars.begin()));
+
+    unit_assert(data.allele_count() == allele_count);
+    unit_assert(data.joint_allele_count(data_2) == joint_allele_count);
+    unit_assert(data.allele_frequency() == chars.allele_frequency());
+
+    // mutation unpacks
+
+    data.set(3, 0);
+    unit_assert(!data.packed());
+    unit_assert(data.at(3) == 0 && data.at(4) == chars.at(4));
+    unit_assert_throws(data.at(n), out_of_range);
+
+    // non-binary alleles stay as chars
+
+    GenotypeData data_3(data);
+    data_3.push_back(genotype_make_pair(2, 0));
+    unit_assert(!data_3.pack(words, 0));
+    unit_assert(!data_3.packed() && data_3.size() == n+1);
+    unit_assert(data_2.packed() && data_2 == data_2); // unaffected
+
+    unit_assert_throws(data.pack(words, stride + 1), runtime_error);
+}
+
+
+void test_deferred()
+{
+    if (os_) *os_ << "test_deferred()\n";
+
+    Organisms organisms;
+
+    for (unsigned int n=0; n<5; ++n)
+    {
+        Organism::Gamete gametes[2];
+
+        for (unsigned int which=0; which<2; ++which)
+        for (unsigned int pair=0; pair<2; ++pair)
+        {
+            HaplotypeChunks chunks;
+            for (unsigned int i=0; i<=n; ++i)
+                chunks.push_back(HaplotypeChunk(i*100000, (n+i+which+pair)%2));
+            gametes[which].push_back(Chromosome(chunks));
+        }
+
+        organisms.push_back(Organism(gametes[0], gametes[1]));
+    }
+
+    Population_Organisms population(organisms);
+
+    Loci loci_eager, loci_deferred;
+    loci_eager.insert(Locus("", 0, 50000));
+    for (unsigned int position=0; position<500000; position+=100000)
+    {
+        loci_deferred.insert(Locus("", 0, position + 25000));
+        loci_deferred.insert(Locus("", 1, position + 25000));
+    }
+
+    Loci loci_all(loci_eager);
+    loci_all.insert(loci_deferred.begin(), loci_deferred.end());
+
+    VariantIndicator_Test indicator;
+    Genotyper genotyper;
+
+    GenotypeMap expected;
+    genotyper.genotype(loci_all, population, indicator, expected);
+
+    GenotypeMap genotype_map;
+    genotyper.genotype(loci_eager, population, indicator, genotype_map);
+    genotype_map.defer(loci_deferred, population, indicator, genotyper);
+
+    unit_assert(genotype_map.genotyped_count() == 1);
+    unit_assert(genotype_map.deferred_count() == 10);
+    unit_assert(genotype_map.computed_count() == 0);
+    unit_assert(genotype_map.loci() == loci_all);
+    unit_assert(genotype_map.contains(Locus("", 0, 25000))); // deferred
+    unit_assert(!genotype_map.contains(Locus("", 0, 25001)));
+
+    // first get() on a chromosome pair genotypes its deferred loci
+
+    const Locus locus_1("", 1, 225000);
+    unit_assert(*genotype_map.get(locus_1) == *expected.get(locus_1));
+    unit_assert(genotype_map.genotyped_count() == 6);
+    unit_assert(genotype_map.computed_count() == 5);
+
+    GenotypeDataPtr memoized = genotype_map.get(locus_1);
+    unit_assert(genotype_map.get(locus_1).get() == memoized.get());
+    unit_assert(genotype_map.computed_count() == 5);
+
+    // loci not yet genotyped are dropped at the end of the deferral
+
+    genotype_map.end_deferral();
+    unit_assert(genotype_map.loci().size() == 6);
+    unit_assert(*genotype_map.get(Locus("", 0, 50000)) == *expected.get(Locus("", 0, 50000)));
+    unit_assert(!genotype_map.contains(Locus("", 0, 25000)));
+    unit_assert_throws(genotype_map.get(Locus("", 0, 25000)), runtime_error);
+}
+
+
 void test_map_get()
 {
     GenotypeDataPtr data(new GenotypeData);
     Locus locus("locus", 1, 100000);
     Locus locus_bad("locus_bad", 2, 200000);
     GenotypeMap gm;
-    gm[locus] = data;
+    gm.set(locus, data);
 
     GenotypeDataPtr retrieved = gm.get(locus); // ok
     unit_assert(retrieved.get() == data.get());
@@ -247,7 +591,7 @@ void test_map_get()
     // try to retrieve null data vector
 
     GenotypeDataPtr null;
-    gm[locus_bad] = null;
+    gm.set(locus_bad, null);
     caught = false;
     try
     {
@@ -266,7 +610,12 @@ void test()
 {
     test_genotype_easy();
     test_genotype_harder();
+    test_genotype_multiple_loci();
+    test_genotype_methods();
+    test_genotype_planes();
     test_allele_frequency();
+    test_pack();
+    test_deferred();
     test_map_get();
 }
 
@@ -0,0 +1,323 @@
+//
+// HaplotypeChunkIndex.cpp
+//
+// Created by Darren Kessner with John Novembre
+//
+// Copyright (c) 2013 Regents of the University of California
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// * Neither UCLA nor the names of its contributors may be used to endorse or
+// promote products derived from this software without specific prior
+// written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "HaplotypeChunkIndex.hpp"
+#include "Population.hpp"
+#include "boost/cstdint.hpp"
+#include <stdexcept>
+
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAPLOTYPECHUNKINDEX_X86
+#include <immintrin.h>
+#endif
+
+
+using namespace std;
+
+
+//
+// search kernels
+//
+
+
+namespace {
+
+
+size_t search_scalar(const unsigned int* positions, size_t count, unsigned int value)
+{
+    // branchless binary search; invariant: base[0] <= value
+
+    const unsigned int* base = positions;
+    size_t n = count;
+
+    while (n > 1)
+    {
+        const size_t half = n / 2;
+        base = (base[half] <= value) ? base + half : base;
+        n -= half;
+    }
+
+    return base - positions;
+}
+
+
+#ifdef HAPLOTYPECHUNKINDEX_X86
+
+
+// The SIMD kernels narrow the range with the branchless binary search, then
+// count the elements <= value in the remaining window.  Positions are unsigned,
+// so both sides of the (signed) comparison are biased by 2^31.
+
+
+__attribute__((target("sse2")))
+size_t search_sse2(const unsigned int* positions, size_t count, unsigned int value)
+{
+    const size_t window = 16;
+
+    const unsigned int* base = positions;
+    size_t n = count;
+
+    while (n > window)
+    {
+        const size_t half = n / 2;
+        base = (base[half] <= value) ? base + half : base;
+        n -= half;
+    }
+
+    const __m128i bias = _mm_set1_epi32(0x80000000);
+    const __m128i biased_value = _mm_xor_si128(_mm_set1_epi32(value), bias);
+
+    // comparison results are -1 (true) or 0, so subtracting them counts 
+    __m128i counts = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(base + i)), bias);
+        counts = _mm_sub_epi32(counts, _mm_cmpgt_epi32(x, biased_value));
+    }
+
+    counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(1,0,3,2)));
+    counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(2,3,0,1)));
+    size_t greater = _mm_cvtsi128_si32(counts);
+
+    for (; i<n; ++i)
+        greater += (base[i] > value);
+
+    return (base - positions) + (n - greater) - 1;
+}
+
+
+__attribute__((target("avx2")))
+size_t search_avx2(const unsigned int* positions, size_t count, unsigned int value)
+{
+    const size_t window = 32;
+
+    const unsigned int* base = positions;
+    size_t n = count;
+
+    while (n > window)
+    {
+        const size_t half = n / 2;
+        base = (base[half] <= value) ? base + half : base;
+        n -= half;
+    }
+
+    const __m256i bias = _mm256_set1_epi32(0x80000000);
+    const __m256i biased_value = _mm256_xor_si256(_mm256_set1_epi32(value), bias);
+
+    __m256i counts = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(base + i)), bias);
+        counts = _mm256_sub_epi32(counts, _mm256_cmpgt_epi32(x, biased_value));
+    }
+
+    __m128i counts128 = _mm_add_epi32(_mm256_castsi256_si128(counts), _mm256_extracti128_si256(counts, 1));
+    counts128 = _mm_add_epi32(counts128, _mm_shuffle_epi32(counts128, _MM_SHUFFLE(1,0,3,2)));
+    counts128 = _mm_add_epi32(counts128, _mm_shuffle_epi32(counts128, _MM_SHUFFLE(2,3,0,1)));
+    size_t greater = _mm_cvtsi128_si32(counts128);
+
+    for (; i<n; ++i)
+        greater += (base[i] > value);
+
+    return (base - positions) + (n - greater) - 1;
+}
+
+
+#endif // HAPLOTYPECHUNKINDEX_X86
+
+
+} // namespace
+
+
+//
+// HaplotypeChunkIndex
+//
+
+
+HaplotypeChunkIndex::HaplotypeChunkIndex(Kernel kernel)
+:   kernel_(kernel == Kernel_Auto ? best_kernel() : kernel),
+    search_(search_function(kernel_)),
+    chromosome_pair_index_(0)
+{}
+
+
+void HaplotypeChunkIndex::build(const Population& population, size_t chromosome_pair_index)
+{
+    chromosome_pair_index_ = chromosome_pair_index;
+    positions_.clear();
+    ids_.clear();
+    offsets_.clear();
+    dense_ids_.clear();
+    id_table_.clear();
+    offsets_.reserve(2*population.population_size() + 1);
+    offsets_.push_back(0);
+
+    const ChromosomePairRangeIterator range_end = population.end();
+    for (const ChromosomePairRangeIterator range=population.begin(); range!=range_end; ++range)
+    {
+        if (chromosome_pair_index >= range->size())
+            throw runtime_error("[HaplotypeChunkIndex::build()] chromosome_pair_index out of range.");
+
+        const ChromosomePair& cp = range->begin()[chromosome_pair_index];
+        const HaplotypeChunks* chunks[] = {&cp.first.haplotype_chunks(), &cp.second.haplotype_chunks()};
+
+        for (size_t i=0; i<2; ++i)
+        {
+            if (chunks[i]->empty())
+                throw runtime_error("[HaplotypeChunkIndex::build()] Empty chromosome.");
+
+            for (HaplotypeChunks::const_iterator it=chunks[i]->begin(); it!=chunks[i]->end(); ++it)
+            {
+                positions_.push_back(it->position);
+                ids_.push_back(it->id);
+            }
+
+            offsets_.push_back(positions_.size());
+        }
+    }
+}
+
+
+void HaplotypeChunkIndex::compact_ids()
+{
+    // sort (id, chunk) keys with an LSD radix sort on the id bytes, skipping
+    // bytes that are the same for all ids (e.g. high bytes of small ids), 
+    // then number the ids in a single pass
+
+    const size_t count = ids_.size();
+    vector<boost::uint64_t> keys(count);
+    vector<boost::uint64_t> buffer(count);
+
+    unsigned int ids_or = 0, ids_and = ~0u;
+    for (size_t i=0; i<count; ++i)
+    {
+        keys[i] = (boost::uint64_t(ids_[i]) << 32) | i;
+        ids_or |= ids_[i];
+        ids_and &= ids_[i];
+    }
+
+    for (unsigned int shift=32; shift<64; shift+=8)
+    {
+        if ((((ids_or ^ ids_and) >> (shift-32)) & 0xff) == 0) continue; // byte is constant
+
+        size_t offsets[257] = {0};
+        for (size_t i=0; i<count; ++i)
+            ++offsets[((keys[i] >> shift) & 0xff) + 1];
+        for (size_t j=1; j<257; ++j)
+            offsets[j] += offsets[j-1];
+        for (size_t i=0; i<count; ++i)
+            buffer[offsets[(keys[i] >> shift) & 0xff]++] = keys[i];
+
+        keys.swap(buffer);
+    }
+
+    dense_ids_.resize(count);
+    id_table_.clear();
+
+    for (size_t i=0; i<count; ++i)
+    {
+        const unsigned int id = static_cast<unsigned int>(keys[i] >> 32);
+        if (id_table_.empty() || id_table_.back() != id)
+            id_table_.push_back(id);
+        dense_ids_[static_cast<size_t>(keys[i] & 0xffffffffu)] = static_cast<unsigned int>(id_table_.size() - 1);
+    }
+}
+
+
+bool HaplotypeChunkIndex::kernel_supported(Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Kernel_Auto:
+        case Kernel_Scalar:
+            return true;
+#ifdef HAPLOTYPECHUNKINDEX_X86
+        case Kernel_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case Kernel_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+
+HaplotypeChunkIndex::Kernel HaplotypeChunkIndex::best_kernel()
+{
+    static Kernel best = kernel_supported(Kernel_AVX2) ? Kernel_AVX2 :
+                         kernel_supported(Kernel_SSE2) ? Kernel_SSE2 :
+                         Kernel_Scalar;
+    return best;
+}
+
+
+HaplotypeChunkIndex::SearchFunction HaplotypeChunkIndex::search_function(Kernel kernel)
+{
+    if (kernel == Kernel_Auto) kernel = best_kernel();
+
+    if (!kernel_supported(kernel))
+        throw runtime_error(string("[HaplotypeChunkIndex::search_function()] Kernel not supported: ") + kernel_name(kernel));
+
+    switch (kernel)
+    {
+#ifdef HAPLOTYPECHUNKINDEX_X86
+        case Kernel_SSE2: return search_sse2;
+        case Kernel_AVX2: return search_avx2;
+#endif
+        default: return search_scalar;
+    }
+}
+
+
+const char* HaplotypeChunkIndex::kernel_name(Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Kernel_Auto: return "auto";
+        case Kernel_Scalar: return "scalar";
+        case Kernel_SSE2: return "sse2";
+        case Kernel_AVX2: return "avx2";
+        default: return "unknown";
+    }
+}
+
+
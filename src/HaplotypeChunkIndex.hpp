@@ -0,0 +1,132 @@
+//
+// HaplotypeChunkIndex.hpp
+//
+// Created by Darren Kessner with John Novembre
+//
+// Copyright (c) 2013 Regents of the University of California
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// * Neither UCLA nor the names of its contributors may be used to endorse or
+// promote products derived from this software without specific prior
+// written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef _HAPLOTYPECHUNKINDEX_HPP_
+#define _HAPLOTYPECHUNKINDEX_HPP_
+
+
+#include <vector>
+#include <cstddef>
+
+
+class Population;
+
+
+//
+// HaplotypeChunkIndex
+//
+// Structure-of-arrays copy of the HaplotypeChunks for a single chromosome 
+// pair index of all organisms in a Population:  chunk positions and ids are
+// held in separate contiguous arrays, so that breakpoint searches touch only
+// positions and can use SIMD kernels.
+//
+// Chromosome i of organism n has chromosome_index 2*n+i.
+//
+// Search kernels return the index of the last position <= value in a sorted
+// array positions[0,count), assuming positions[0] <= value (always true for
+// HaplotypeChunks, which begin at position 0).  The kernel is chosen at 
+// runtime (AVX2, SSE2, or scalar branchless binary search), and may be 
+// overridden for testing/benchmarking.
+//
+// compact_ids() renumbers the distinct chunk ids in the index to a dense
+// range [0, id_count()), keeping the translation back to the original ids;
+// callers that consume ids in bulk can then use flat arrays indexed by 
+// dense id instead of maps or searches over the original id space.  The
+// Population itself is not modified.
+//
+
+
+class HaplotypeChunkIndex
+{
+    public:
+
+    enum Kernel {Kernel_Auto, Kernel_Scalar, Kernel_SSE2, Kernel_AVX2};
+
+    typedef size_t (*SearchFunction)(const unsigned int* positions, size_t count, unsigned int value);
+
+    HaplotypeChunkIndex(Kernel kernel = Kernel_Auto);
+
+    void build(const Population& population, size_t chromosome_pair_index);
+
+    size_t chromosome_pair_index() const {return chromosome_pair_index_;}
+    size_t chromosome_count() const {return offsets_.empty() ? 0 : offsets_.size() - 1;}
+    size_t chunk_count() const {return positions_.size();}
+
+    // id of the HaplotypeChunk containing position
+    unsigned int find_id(size_t chromosome_index, unsigned int position) const
+    {
+        const size_t begin = offsets_[chromosome_index];
+        const size_t count = offsets_[chromosome_index+1] - begin;
+        return ids_[begin + search_(&positions_[begin], count, position)];
+    }
+
+    // dense id renumbering (invalidated by build())
+
+    void compact_ids();
+    bool compacted() const {return !dense_ids_.empty();}
+    size_t id_count() const {return id_table_.size();}
+    unsigned int id(size_t dense_id) const {return id_table_[dense_id];} // dense -> original
+
+    // dense id of the HaplotypeChunk containing position; requires compact_ids()
+    unsigned int find_dense_id(size_t chromosome_index, unsigned int position) const
+    {
+        const size_t begin = offsets_[chromosome_index];
+        const size_t count = offsets_[chromosome_index+1] - begin;
+        return dense_ids_[begin + search_(&positions_[begin], count, position)];
+    }
+
+    Kernel kernel() const {return kernel_;}
+
+    // kernel dispatch
+
+    static bool kernel_supported(Kernel kernel);
+    static Kernel best_kernel();
+    static SearchFunction search_function(Kernel kernel); // throws if unsupported
+    static const char* kernel_name(Kernel kernel);
+
+    private:
+
+    Kernel kernel_;
+    SearchFunction search_;
+    size_t chromosome_pair_index_;
+    std::vector<unsigned int> positions_;
+    std::vector<unsigned int> ids_;
+    std::vector<size_t> offsets_; // chromosome_index -> first chunk, size chromosome_count()+1
+    std::vector<unsigned int> dense_ids_; // parallel to ids_, empty unless compacted
+    std::vector<unsigned int> id_table_; // dense id -> original id (sorted)
+};
+
+
+#endif // _HAPLOTYPECHUNKINDEX_HPP_
+
@@ -0,0 +1,237 @@
+//
+// HaplotypeChunkIndexTest.cpp
+//
+// Created by Darren Kessner with John Novembre
+//
+// Copyright (c) 2013 Regents of the University of California
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// * Neither UCLA nor the names of its contributors may be used to endorse or
+// promote products derived from this software without specific prior
+// written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "HaplotypeChunkIndex.hpp"
+#include "Population_Organisms.hpp"
+#include "unit.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+
+using namespace std;
+
+
+ostream* os_ = 0;
+//ostream* os_ = &cout;
+
+
+size_t search_reference(const vector<unsigned int>& positions, unsigned int value)
+{
+    return upper_bound(positions.begin(), positions.end(), value) - positions.begin() - 1;
+}
+
+
+void test_kernel(HaplotypeChunkIndex::Kernel kernel)
+{
+    if (os_) *os_ << "test_kernel() " << HaplotypeChunkIndex::kernel_name(kernel) << endl;
+
+    HaplotypeChunkIndex::SearchFunction search = HaplotypeChunkIndex::search_function(kernel);
+
+    srand(123);
+
+    for (size_t count=1; count<200; ++count)
+    {
+        // sorted positions beginning at 0, spanning the full unsigned range
+
+        vector<unsigned int> positions(1, 0);
+        for (size_t i=1; i<count; ++i)
+            positions.push_back(positions.back() + 1 + (unsigned int)(rand() % (0xffffffffu / 200)));
+
+        // probe every breakpoint, its neighbors, and the extremes
+
+        vector<unsigned int> values;
+        for (size_t i=0; i<count; ++i)
+        {
+            values.push_back(positions[i]);
+            values.push_back(positions[i] + 1);
+            if (positions[i] > 0) values.push_back(positions[i] - 1);
+        }
+        values.push_back(0xffffffffu);
+        values.push_back(0x80000000u);
+
+        for (vector<unsigned int>::const_iterator value=values.begin(); value!=values.end(); ++value)
+            unit_assert(search(&positions[0], count, *value) == search_reference(positions, *value));
+    }
+}
+
+
+void test_kernels()
+{
+    const HaplotypeChunkIndex::Kernel kernels[] = {HaplotypeChunkIndex::Kernel_Scalar,
+                                                   HaplotypeChunkIndex::Kernel_SSE2,
+                                                   HaplotypeChunkIndex::Kernel_AVX2};
+
+    for (size_t i=0; i<sizeof(kernels)/sizeof(kernels[0]); ++i)
+    {
+        if (HaplotypeChunkIndex::kernel_supported(kernels[i]))
+            test_kernel(kernels[i]);
+        else if (os_) 
+            *os_ << "kernel not supported: " << HaplotypeChunkIndex::kernel_name(kernels[i]) << endl;
+    }
+
+    unit_assert(HaplotypeChunkIndex::kernel_supported(HaplotypeChunkIndex::best_kernel()));
+    if (os_) *os_ << "best kernel: " << HaplotypeChunkIndex::kernel_name(HaplotypeChunkIndex::best_kernel()) << endl;
+}
+
+
+void test_build()
+{
+    if (os_) *os_ << "test_build()\n";
+
+    // 5 organisms, 2 chromosome pairs; chromosome pair 1 has 3*n+1 chunks
+
+    Organisms organisms;
+
+    for (unsigned int n=0; n<5; ++n)
+    {
+        Organism::Gamete gametes[2];
+
+        for (unsigned int which=0; which<2; ++which)
+        {
+            gametes[which].push_back(Chromosome(1000 + 2*n + which));
+
+            HaplotypeChunks chunks;
+            for (unsigned int i=0; i<3*n+1; ++i)
+                chunks.push_back(HaplotypeChunk(i*1000 + which*500, 100*n + 10*which + i));
+            chunks.front().position = 0;
+            gametes[which].push_back(Chromosome(chunks));
+        }
+
+        organisms.push_back(Organism(gametes[0], gametes[1]));
+    }
+
+    Population_Organisms population(organisms);
+
+    HaplotypeChunkIndex index;
+    index.build(population, 1);
+    unit_assert(index.chromosome_pair_index() == 1);
+    unit_assert(index.chromosome_count() == 10);
+    unit_assert(index.chunk_count() == 2*(1+4+7+10+13));
+
+    for (size_t n=0; n<organisms.size(); ++n)
+    {
+        const ChromosomePair& cp = organisms[n].chromosomePairs()[1];
+
+        for (unsigned int position=0; position<15000; position+=250)
+        {
+            unit_assert(index.find_id(2*n, position) == cp.first.find_haplotype_chunk(position)->id);
+            unit_assert(index.find_id(2*n+1, position) == cp.second.find_haplotype_chunk(position)->id);
+        }
+    }
+
+    // dense ids: chunk ids 100*n + 10*which + i, with some repeats for n==4
+
+    unit_assert(!index.compacted());
+    index.compact_ids();
+    unit_assert(index.compacted());
+    unit_assert(index.id_count() == index.chunk_count() - 3);
+
+    for (size_t j=1; j<index.id_count(); ++j)
+        unit_assert(index.id(j-1) < index.id(j));
+
+    for (size_t i=0; i<index.chromosome_count(); ++i)
+    for (unsigned int position=0; position<15000; position+=250)
+    {
+        const unsigned int dense_id = index.find_dense_id(i, position);
+        unit_assert(dense_id < index.id_count());
+        unit_assert(index.id(dense_id) == index.find_id(i, position));
+    }
+
+    index.build(population, 0);
+    unit_assert(!index.compacted());
+    unit_assert(index.chunk_count() == 10);
+    unit_assert(index.find_id(7, 123456) == 1007);
+
+    // shared ids: chromosome pair 0 of organisms 0,1 set to the same ids
+
+    Organism::Gamete gamete;
+    gamete.push_back(organisms[0].chromosomePairs()[0].first);
+    gamete.push_back(organisms[0].chromosomePairs()[1].first);
+    organisms[1] = Organism(gamete, gamete);
+    Population_Organisms population_shared(organisms);
+    index.build(population_shared, 0);
+    index.compact_ids();
+    unit_assert(index.id_count() == 8);
+
+    for (size_t i=0; i<index.chromosome_count(); ++i)
+        unit_assert(index.id(index.find_dense_id(i, 500)) == index.find_id(i, 500));
+
+    unit_assert(index.find_dense_id(0, 0) == 0);
+    unit_assert(index.find_dense_id(2, 0) == 0);
+    unit_assert(index.find_dense_id(3, 0) == 0);
+    unit_assert(index.find_dense_id(1, 0) == 1);
+    unit_assert(index.find_dense_id(9, 0) == 7);
+
+    bool caught = false;
+    try
+    {
+        index.build(population, 2);
+    }
+    catch (exception& e)
+    {
+        if (os_) *os_ << "caught exception:\n" << e.what() << endl;
+        caught = true;
+    }
+    unit_assert(caught);
+}
+
+
+void test()
+{
+    test_kernels();
+    test_build();
+}
+
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        if (argc>1 && !strcmp(argv[1],"-v")) os_ = &cout;
+        test();
+        return 0;
+    }
+    catch(exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    catch(...)
+    {
+        cerr << "Caught unknown exception.\n";
+        return 1;
+    }
+}
@@ -0,0 +1,107 @@
+//
+// IDSet.cpp
+//
+// Created by Darren Kessner with John Novembre
+//
+// Copyright (c) 2013 Regents of the University of California
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// * Neither UCLA nor the names of its contributors may be used to endorse or
+// promote products derived from this software without specific prior
+// written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "IDSet.hpp"
+#include <algorithm>
+
+
+using namespace std;
+
+
+IDSet::IDSet(const vector<unsigned int>& ids)
+:   bits_begin_(0)
+{
+    insert(ids);
+}
+
+
+void IDSet::insert(const vector<unsigned int>& ids)
+{
+    if (ids.empty()) return;
+
+    const size_t old_size = ids_.size();
+    ids_.insert(ids_.end(), ids.begin(), ids.end());
+    sort(ids_.begin() + old_size, ids_.end());
+    inplace_merge(ids_.begin(), ids_.begin() + old_size, ids_.end());
+    ids_.erase(unique(ids_.begin(), ids_.end()), ids_.end());
+    vector<unsigned int>(ids_).swap(ids_); // trim capacity
+
+    index();
+}
+
+
+bool IDSet::search(unsigned int id) const
+{
+    // branchless binary search: base ends at the last element <= id
+
+    if (ids_.empty() || id < ids_[0]) return false;
+
+    const unsigned int* base = &ids_[0];
+    size_t n = ids_.size();
+
+    while (n > 1)
+    {
+        const size_t half = n >> 1;
+        base = (base[half] <= id) ? base + half : base;
+        n -= half;
+    }
+
+    return *base == id;
+}
+
+
+void IDSet::index()
+{
+    // build the bitset only if it is no larger than the sorted array:
+    // range/8 bytes <= 4*size bytes
+
+    vector<boost::uint64_t>().swap(bits_);
+    bits_begin_ = 0;
+
+    if (ids_.empty()) return;
+
+    const size_t range = size_t(ids_.back()) - ids_.front() + 1;
+    if (range > 32 * ids_.size()) return;
+
+    bits_begin_ = ids_.front();
+    bits_.resize((range + 63) >> 6);
+
+    for (const_iterator it=ids_.begin(); it!=ids_.end(); ++it)
+    {
+        const unsigned int offset = *it - bits_begin_;
+        bits_[offset >> 6] |= boost::uint64_t(1) << (offset & 63);
+    }
+}
+
+
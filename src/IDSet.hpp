@@ -0,0 +1,97 @@
+//
+// IDSet.hpp
+//
+// Created by Darren Kessner with John Novembre
+//
+// Copyright (c) 2013 Regents of the University of California
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// * Neither UCLA nor the names of its contributors may be used to endorse or
+// promote products derived from this software without specific prior
+// written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef _IDSET_HPP_
+#define _IDSET_HPP_
+
+
+#include "boost/cstdint.hpp"
+#include <vector>
+#include <cstddef>
+
+
+//
+// IDSet
+//
+// Compact set of chunk ids:  ids are held in a sorted array, which is used
+// for iteration and (binary search) lookup in sparse sets.  When the ids are 
+// dense in their range (e.g. a random subset of the founder ids of a 
+// population), a bitset over the range is also built, so that count() is 
+// O(1) -- the bitset is never larger than the sorted array.
+//
+
+
+class IDSet
+{
+    public:
+
+    typedef std::vector<unsigned int>::const_iterator const_iterator;
+
+    IDSet() : bits_begin_(0) {}
+
+    // ids may be unsorted and may contain duplicates
+    explicit IDSet(const std::vector<unsigned int>& ids);
+    void insert(const std::vector<unsigned int>& ids);
+
+    size_t count(unsigned int id) const
+    {
+        if (!bits_.empty())
+        {
+            const unsigned int offset = id - bits_begin_; // wraps for id < bits_begin_
+            return offset < (bits_.size() << 6) && ((bits_[offset >> 6] >> (offset & 63)) & 1);
+        }
+
+        return search(id);
+    }
+
+    size_t size() const {return ids_.size();}
+    bool empty() const {return ids_.empty();}
+    const_iterator begin() const {return ids_.begin();}
+    const_iterator end() const {return ids_.end();}
+
+    bool dense() const {return !bits_.empty();} // for testing
+
+    private:
+
+    std::vector<unsigned int> ids_;
+    unsigned int bits_begin_;
+    std::vector<boost::uint64_t> bits_;
+
+    bool search(unsigned int id) const;
+    void index();
+};
+
+
+#endif // _IDSET_HPP_
+
@@ -0,0 +1,184 @@
+//
+// IDSetTest.cpp
+//
+// Created by Darren Kessner with John Novembre
+//
+// Copyright (c) 2013 Regents of the University of California
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// * Neither UCLA nor the names of its contributors may be used to endorse or
+// promote products derived from this software without specific prior
+// written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "IDSet.hpp"
+#include "unit.hpp"
+#include <iostream>
+#include <set>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+
+using namespace std;
+
+
+ostream* os_ = 0;
+//ostream* os_ = &cout;
+
+
+void check(const IDSet& ids, const set<unsigned int>& reference, unsigned int id_end)
+{
+    unit_assert(ids.size() == reference.size());
+    unit_assert(equal(ids.begin(), ids.end(), reference.begin()));
+
+    for (unsigned int id=0; id<id_end; ++id)
+        unit_assert(ids.count(id) == reference.count(id));
+
+    unit_assert(ids.count(-1u) == reference.count(-1u));
+}
+
+
+void test_empty()
+{
+    if (os_) *os_ << "test_empty()\n";
+
+    IDSet ids;
+    unit_assert(ids.empty());
+    unit_assert(!ids.dense());
+    check(ids, set<unsigned int>(), 100);
+
+    ids.insert(vector<unsigned int>());
+    unit_assert(ids.empty());
+}
+
+
+void test_dense()
+{
+    if (os_) *os_ << "test_dense()\n";
+
+    // random half of the founder ids [1000, 3000)
+
+    vector<unsigned int> v;
+    set<unsigned int> reference;
+    for (unsigned int id=1000; id<3000; ++id)
+    {
+        if (rand() % 2 == 0) continue;
+        v.push_back(id);
+        reference.insert(id);
+    }
+
+    random_shuffle(v.begin(), v.end());
+    v.push_back(v.front()); // duplicate
+
+    IDSet ids(v);
+    unit_assert(ids.dense());
+    check(ids, reference, 4000);
+}
+
+
+void test_sparse()
+{
+    if (os_) *os_ << "test_sparse()\n";
+
+    unsigned int a[] = {7, 3, 1000000, 64, 63, 65, 3};
+    vector<unsigned int> v(a, a + sizeof(a)/sizeof(unsigned int));
+    set<unsigned int> reference(v.begin(), v.end());
+
+    IDSet ids(v);
+    unit_assert(!ids.dense());
+    check(ids, reference, 2000);
+    unit_assert(ids.count(1000000) == 1);
+    unit_assert(ids.count(999999) == 0);
+}
+
+
+void test_insert()
+{
+    if (os_) *os_ << "test_insert()\n";
+
+    // populations inserted one at a time:  the set becomes sparse when the
+    // second block is far from the first
+
+    vector<unsigned int> v1, v2;
+    for (unsigned int id=0; id<100; id+=2) v1.push_back(id);
+    for (unsigned int id=1000000; id<1000100; id+=3) v2.push_back(id);
+
+    set<unsigned int> reference(v1.begin(), v1.end());
+
+    IDSet ids(v1);
+    unit_assert(ids.dense());
+    check(ids, reference, 200);
+
+    ids.insert(v2);
+    ids.insert(v1); // no change
+    reference.insert(v2.begin(), v2.end());
+    unit_assert(!ids.dense());
+    check(ids, reference, 200);
+
+    for (unsigned int id=999900; id<1000200; ++id)
+        unit_assert(ids.count(id) == reference.count(id));
+
+    // the bitset boundary:  the last word is partially used
+
+    vector<unsigned int> v3;
+    v3.push_back(64);
+    v3.push_back(64 + 70);
+    for (unsigned int id=70; id<80; ++id) v3.push_back(id);
+    IDSet ids3(v3);
+    unit_assert(ids3.dense());
+    check(ids3, set<unsigned int>(v3.begin(), v3.end()), 300);
+}
+
+
+void test()
+{
+    test_empty();
+    test_dense();
+    test_sparse();
+    test_insert();
+}
+
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        if (argc>1 && !strcmp(argv[1],"-v")) os_ = &cout;
+        test();
+        return 0;
+    }
+    catch(exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    catch(...)
+    {
+        cerr << "Caught unknown exception.\n";
+        return 1;
+    }
+}
+
+
@@ -372,7 +372,7 @@ string MSFormatIDMapper::sequence(const Chromosome& chromosome) const
 {
     string sequence;
 
-    for (vector<HaplotypeChunk>::const_iterator it=chromosome.haplotype_chunks().begin(); 
+    for (HaplotypeChunks::const_iterator it=chromosome.haplotype_chunks().begin(); 
          it!=chromosome.haplotype_chunks().end(); ++it)
     {
         double begin = relative_position_(it->position);
@@ -52,9 +52,9 @@ MutationGenerator_SingleLocus::MutationInfos MutationGenerator_SingleLocus::gene
 {
     // note: rate must be calculated each generation, since population size may change
     const double rate = 2 * population.population_size() * mu_; // per chromosome
-    Random::DistributionPtr poisson = Random::create_poisson_distribution("id_dummy", rate);
+    poisson_.mean(rate);
 
-    size_t mutant_count = size_t(poisson->random_value());
+    size_t mutant_count = size_t(poisson_());
 
     vector<size_t> chromosome_indices = 
         Random::random_indices_without_replacement(2 * population.population_size(), mutant_count);
@@ -121,14 +121,17 @@ MutationGenerator_Regions::MutationInfos MutationGenerator_Regions::generate_mut
 {
     MutationInfos result;
 
-    for (RegionInfos::const_iterator region_info=region_infos_.begin(); region_info!=region_infos_.end(); ++region_info)
+    poissons_.resize(region_infos_.size());
+    vector<Random::Poisson>::iterator poisson = poissons_.begin();
+
+    for (RegionInfos::const_iterator region_info=region_infos_.begin(); region_info!=region_infos_.end(); ++region_info, ++poisson)
     {
         const double mu = region_info->mutation_rate->value(generation_index, population_index); // per site, per chromosome, per generation
         const size_t total_site_count = region_info->length * 2 * population.population_size();
         const double rate = mu * total_site_count;
-        Random::DistributionPtr poisson = Random::create_poisson_distribution("id_dummy", rate);
+        poisson->mean(rate);
 
-        size_t mutant_count = size_t(poisson->random_value());
+        size_t mutant_count = size_t((*poisson)());
 
         vector<size_t> total_site_indices = 
             Random::random_indices_without_replacement(total_site_count, mutant_count);
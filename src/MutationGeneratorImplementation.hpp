@@ -39,6 +39,7 @@
 
 #include "MutationGenerator.hpp"
 #include "Trajectory.hpp"
+#include "Random.hpp"
 
 
 ///
@@ -95,6 +96,7 @@ class MutationGenerator_SingleLocus : public MutationGenerator
 
     Locus locus_;
     double mu_;
+    mutable Random::Poisson poisson_; // mutant count; mean depends on population size
 };
 
 
@@ -159,6 +161,7 @@ class MutationGenerator_Regions : public MutationGenerator
     private:
 
     RegionInfos region_infos_;
+    mutable std::vector<Random::Poisson> poissons_; // mutant count for each region
 };
 
 
@@ -69,12 +69,17 @@ Organism::Organism(const Organism& mom, const Organism& dad,
 
     this->chromosomePairs_.reserve(mom.chromosomePairs_.size());
 
+    vector<unsigned int> positions_mom;
+    vector<unsigned int> positions_dad;
+
     size_t chromosome_index = 0;
     for (ChromosomePairs::const_iterator it=mom.chromosomePairs_.begin(), jt=dad.chromosomePairs_.begin();
          it!=mom.chromosomePairs_.end(); ++it, ++jt, ++chromosome_index)
     {
-        vector<unsigned int> positions_mom = recombination_position_generator.get_positions(chromosome_index);
-        vector<unsigned int> positions_dad = recombination_position_generator.get_positions(chromosome_index);
+        positions_mom.clear();
+        positions_dad.clear();
+        recombination_position_generator.append_positions(chromosome_index, positions_mom);
+        recombination_position_generator.append_positions(chromosome_index, positions_dad);
 
         this->chromosomePairs_.push_back(make_pair(
             Chromosome(it->first, it->second, positions_mom),
@@ -104,13 +109,12 @@ Organism::Gamete Organism::create_gamete(const RecombinationPositionGenerator& r
 {
     Gamete result;
 
-    for (ChromosomePairs::const_iterator it=chromosomePairs_.begin(); it!=chromosomePairs_.end(); ++it)
-    {
-        vector<unsigned int> positions = 
-            recombination_position_generator.get_positions(it-chromosomePairs_.begin());
+    vector< vector<unsigned int> > positions(chromosomePairs_.size());
+    if (!positions.empty())
+        recombination_position_generator.get_gamete_positions(positions.size(), &positions[0]);
 
-        result.push_back(Chromosome(it->first, it->second, positions));
-    }
+    for (ChromosomePairs::const_iterator it=chromosomePairs_.begin(); it!=chromosomePairs_.end(); ++it)
+        result.push_back(Chromosome(it->first, it->second, positions[it-chromosomePairs_.begin()]));
 
     return result;
 }
@@ -36,6 +36,10 @@
 #include "Population.hpp"
 #include "Population_ChromosomePairs.hpp"
 #include "Random.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/barrier.hpp"
+#include "boost/bind/bind.hpp"
 #include <stdexcept>
 #include <iostream>
 #include <sstream>
@@ -43,6 +47,7 @@
 #include <set>
 #include <fstream>
 #include <cmath>
+#include <algorithm>
 
 
 using namespace std;
@@ -84,6 +89,12 @@ void MatingDistribution::validate_entries(const PopulationDataPtrs& population_d
 
 
 const MatingDistribution::Entry& MatingDistribution::random() const
+{
+    return entries_[random_index()];
+}
+
+
+size_t MatingDistribution::random_index() const
 {
     const size_t max_attempts = 10000;
 
@@ -98,12 +109,12 @@ const MatingDistribution::Entry& MatingDistribution::random() const
         {
             cout << "total weight: " << total_weight() << endl;
             cout << "roll: " << roll << endl;
-            throw runtime_error("[MatingDistribution::random()] This isn't happening.");
+            throw runtime_error("[MatingDistribution::random_index()] This isn't happening.");
         }
 
-        const Entry& entry = entries_[it - cumulative_weights_.begin()];
+        const size_t index = it - cumulative_weights_.begin();
         
-        if (entry.valid) return entry;
+        if (entries_[index].valid) return index;
     }
 
     throw runtime_error("[MatingDistribution] Something's wrong: no valid entries?");
@@ -494,14 +505,21 @@ class RandomOrganismIndexGenerator
     public:
 
     RandomOrganismIndexGenerator(size_t population_size,
-                                 const DataVectorPtr& fitness_vector)
+                                 const DataVectorPtr& fitness_vector,
+                                 Random::AliasTable* alias_table)
     :   population_size_(population_size),
-        fitness_cdf_max_(0)
+        fitness_cdf_max_(0),
+        alias_table_(0)
     {
         if (population_size == 0)
             throw runtime_error("[RandomOrganismIndexGenerator] Population size 0.");
 
-        if (fitness_vector.get()) 
+        if (fitness_vector.get() && alias_table)
+        {
+            alias_table_ = alias_table;
+            alias_table_->assign(*fitness_vector);
+        }
+        else if (fitness_vector.get()) 
         {
             fitness_cdf_ = fitness_vector->cdf(); // memory allocation for cdf
 
@@ -514,7 +532,11 @@ class RandomOrganismIndexGenerator
 
     size_t operator()() const
     {
-        if (!fitness_cdf_.get()) 
+        if (alias_table_)
+        {
+            return (*alias_table_)(); // pick random index according to fitnesses, O(1)
+        }
+        else if (!fitness_cdf_.get()) 
         {
             return Random::uniform_integer(0, population_size_-1); // uniform random index
         }
@@ -532,6 +554,7 @@ class RandomOrganismIndexGenerator
     size_t population_size_;
     DataVectorPtr fitness_cdf_;
     double fitness_cdf_max_;
+    Random::AliasTable* alias_table_; // owned by the Population being created
 };
 
 
@@ -542,10 +565,17 @@ class RandomOrganismIndexGeneratorMap
 {
     public:
 
+    // alias tables are taken in turn from alias_tables (null: parents are drawn
+    // from the cumulative distribution), which is extended as needed; the caller 
+    // keeps it across generations so that rebuilding the tables does not allocate
+
     RandomOrganismIndexGeneratorMap(const PopulationDataPtrs& population_datas,
-                                    string default_fitness_function)
+                                    string default_fitness_function,
+                                    vector< shared_ptr<Random::AliasTable> >* alias_tables)
     :   population_datas_(population_datas),
-        default_fitness_function_(default_fitness_function)
+        default_fitness_function_(default_fitness_function),
+        alias_tables_(alias_tables),
+        alias_table_count_(0)
     {}
 
     RandomOrganismIndexGeneratorPtr get(size_t population_index, string fitness_function)
@@ -569,9 +599,13 @@ class RandomOrganismIndexGeneratorMap
             if (fitness.get() && fitness->size() != population_size)
                 throw runtime_error("[Population::RandomOrganismIndexGeneratorMap] Bad population size.");
 
+            Random::AliasTable* alias_table = 0;
+            if (fitness.get() && alias_tables_)
+                alias_table = next_alias_table();
+
             generator_map_[key] =
                 RandomOrganismIndexGeneratorPtr(
-                    new RandomOrganismIndexGenerator(population_size, fitness));
+                    new RandomOrganismIndexGenerator(population_size, fitness, alias_table));
         }
 
         return generator_map_[key];
@@ -581,6 +615,15 @@ class RandomOrganismIndexGeneratorMap
 
     const PopulationDataPtrs& population_datas_;
     string default_fitness_function_;
+    vector< shared_ptr<Random::AliasTable> >* alias_tables_;
+    size_t alias_table_count_; // tables handed out so far
+
+    Random::AliasTable* next_alias_table()
+    {
+        if (alias_table_count_ == alias_tables_->size())
+            alias_tables_->push_back(shared_ptr<Random::AliasTable>(new Random::AliasTable));
+        return (*alias_tables_)[alias_table_count_++].get();
+    }
 
     typedef pair<size_t,string> Key;
     typedef map<Key,RandomOrganismIndexGeneratorPtr> GeneratorMap;
@@ -588,16 +631,344 @@ class RandomOrganismIndexGeneratorMap
 };
 
 
+
+struct Mating
+{
+    size_t population_mom;
+    size_t index_mom;
+    size_t population_dad;
+    size_t index_dad;
+};
+
+
+// draw recombination positions for one chromosome pair into positions[0] (mom)
+// and positions[1] (dad), reusing their capacity
+
+void draw_positions(const RecombinationPositionGeneratorPtrs& recombination_position_generators,
+                    size_t chromosome_pair_index, vector<unsigned int>* positions)
+{
+    positions[0].clear();
+    positions[1].clear();
+    recombination_position_generators[0]->append_positions(chromosome_pair_index, positions[0]);
+    recombination_position_generators[1]->append_positions(chromosome_pair_index, positions[1]);
+}
+
+
+// MatingTable: each valid MatingDistribution::Entry is resolved to its pair of
+// RandomOrganismIndexGenerators before any children are created, so that 
+// drawing a mating involves no string handling, map lookup, or allocation.
+// Generators are created without random draws, so resolving up front does not
+// change the random sequence.
+//
+// next() returns the mating for the next child.  With multinomial offspring
+// allocation, the child count for each entry is drawn up front (as a sequence of
+// conditional binomials), and the children of each entry are consecutive.
+
+class MatingTable
+{
+    public:
+
+    MatingTable(const MatingDistribution& mating_distribution,
+                RandomOrganismIndexGeneratorMap& generator_map,
+                size_t child_count,
+                Population::OffspringAllocation offspring_allocation)
+    :   mating_distribution_(mating_distribution),
+        multinomial_(offspring_allocation == Population::OffspringAllocation_Multinomial),
+        current_entry_(0)
+    {
+        const MatingDistribution::Entries& entries = mating_distribution.entries();
+        resolved_entries_.resize(entries.size());
+
+        for (size_t i=0; i<entries.size(); ++i)
+        {
+            const MatingDistribution::Entry& entry = entries[i];
+            if (!entry.valid) continue; // never drawn
+
+            ResolvedEntry& resolved = resolved_entries_[i];
+            resolved.population_mom = entry.first;
+            resolved.population_dad = entry.second;
+            resolved.generator_mom = generator_map.get(entry.first, entry.first_fitness).get();
+            resolved.generator_dad = generator_map.get(entry.second, entry.second_fitness).get();
+        }
+
+        if (multinomial_)
+            allocate_children(child_count);
+    }
+
+    Mating next()
+    {
+        if (!multinomial_)
+            return random_mating(mating_distribution_.random_index());
+
+        while (entry_child_counts_.at(current_entry_) == 0)
+            ++current_entry_;
+
+        --entry_child_counts_[current_entry_];
+        return random_mating(current_entry_);
+    }
+
+    private:
+
+    Mating random_mating(size_t entry_index) const
+    {
+        const ResolvedEntry& entry = resolved_entries_[entry_index];
+
+        Mating mating;
+        mating.population_mom = entry.population_mom;
+        mating.population_dad = entry.population_dad;
+        mating.index_mom = (*entry.generator_mom)();
+        mating.index_dad = 0;
+        do { // avoid selfing
+            mating.index_dad = (*entry.generator_dad)();
+        } while (entry.population_mom == entry.population_dad && mating.index_mom == mating.index_dad);
+
+        return mating;
+    }
+
+    void allocate_children(size_t child_count)
+    {
+        const MatingDistribution::Entries& entries = mating_distribution_.entries();
+
+        double remaining_weight = 0;
+        size_t last_entry = entries.size();
+        for (size_t i=0; i<entries.size(); ++i)
+        {
+            if (!entries[i].valid || entries[i].weight <= 0) continue;
+            remaining_weight += entries[i].weight;
+            last_entry = i;
+        }
+
+        if (last_entry == entries.size())
+            throw runtime_error("[Population::MatingTable] No valid entries.");
+
+        entry_child_counts_.assign(entries.size(), 0);
+        long remaining = long(child_count);
+
+        for (size_t i=0; i<entries.size() && remaining>0; ++i)
+        {
+            if (!entries[i].valid || entries[i].weight <= 0) continue;
+
+            if (i == last_entry)
+            {
+                entry_child_counts_[i] = remaining;
+                break;
+            }
+
+            double p = min(entries[i].weight / remaining_weight, 1.0);
+            entry_child_counts_[i] = Random::binomial(remaining, p);
+            remaining -= entry_child_counts_[i];
+            remaining_weight -= entries[i].weight;
+        }
+    }
+
+    struct ResolvedEntry
+    {
+        size_t population_mom;
+        size_t population_dad;
+        const RandomOrganismIndexGenerator* generator_mom; // owned by RandomOrganismIndexGeneratorMap
+        const RandomOrganismIndexGenerator* generator_dad;
+
+        ResolvedEntry() 
+        :   population_mom(0), population_dad(0), generator_mom(0), generator_dad(0)
+        {}
+    };
+
+    const MatingDistribution& mating_distribution_;
+    vector<ResolvedEntry> resolved_entries_;
+
+    const bool multinomial_;
+    vector<long> entry_child_counts_;
+    size_t current_entry_;
+};
+
+
+//
+// MatingEngine: multithreaded construction of children
+//
+// Children are created in blocks.  For each block, all random draws (mating
+// entry, parents, recombination positions) are made serially, in the same order
+// as the single-threaded loop in create_organisms().  The children of the block
+// are then built in parallel, each worker taking a contiguous slice and storing
+// HaplotypeChunks in its own worker range.  Since the workers make no random
+// draws, the result is identical for any thread count.  The worker threads are
+// started once per generation, and wait on a barrier between blocks.
+//
+// Parental HaplotypeChunks transmitted without recombination are shared with the
+// child; these are made shareable in the serial phase, so that the workers only
+// read the parents.
+//
+
+
+class MatingEngine
+{
+    public:
+
+    MatingEngine(Population& population,
+                 const PopulationPtrs& populations,
+                 const RecombinationPositionGeneratorPtrs& recombination_position_generators,
+                 size_t thread_count)
+    :   population_(population), 
+        populations_(populations),
+        recombination_position_generators_(recombination_position_generators),
+        thread_count_(thread_count),
+        block_size_(children_per_worker_ * thread_count),
+        moms_(block_size_), dads_(block_size_),
+        positions_(block_size_ * population.chromosome_pair_count() * 2),
+        block_begin_(0), block_count_(0), finished_(false),
+        barrier_(unsigned(thread_count))
+    {
+        if (recombination_position_generators.size() != 2)
+            throw runtime_error("[Population::MatingEngine] Recombination position generator count != 2.");
+
+        population_.allocate_workers(thread_count_);
+    }
+
+    void create_children(MatingTable& mating_table)
+    {
+        boost::thread_group workers;
+
+        for (size_t worker=1; worker<thread_count_; ++worker)
+            workers.create_thread(boost::bind(&MatingEngine::work, this, worker));
+
+        try
+        {
+            const size_t population_size = population_.population_size();
+
+            for (size_t block_begin=0; block_begin<population_size && error_.empty(); block_begin+=block_size_)
+            {
+                block_count_ = min(block_size_, population_size - block_begin);
+                block_begin_ = block_begin;
+
+                for (size_t i=0; i<block_count_; ++i)
+                    draw(i, mating_table.next());
+
+                barrier_.wait(); // start of block
+                build_slice(0);
+                barrier_.wait(); // end of block
+            }
+        }
+        catch (...)
+        {
+            stop(workers);
+            throw;
+        }
+
+        stop(workers);
+
+        if (!error_.empty())
+            throw runtime_error(error_);
+    }
+
+    private:
+
+    static const size_t children_per_worker_ = 1024;
+
+    Population& population_;
+    const PopulationPtrs& populations_;
+    const RecombinationPositionGeneratorPtrs& recombination_position_generators_;
+    const size_t thread_count_;
+    const size_t block_size_;
+
+    // per child in block
+    vector<ChromosomePairRange> moms_;
+    vector<ChromosomePairRange> dads_;
+    vector< vector<unsigned int> > positions_; // [child][chromosome pair][mom/dad]
+
+    // current block, written by the main thread before the barrier
+    size_t block_begin_;
+    size_t block_count_;
+    bool finished_;
+    boost::barrier barrier_;
+    
+    string error_;
+    boost::mutex error_mutex_;
+
+    void draw(size_t child, const Mating& mating)
+    {
+        const size_t chromosome_pair_count = population_.chromosome_pair_count();
+
+        moms_[child] = populations_[mating.population_mom]->chromosome_pair_range(mating.index_mom);
+        dads_[child] = populations_[mating.population_dad]->chromosome_pair_range(mating.index_dad);
+
+        if (moms_[child].size() != chromosome_pair_count || dads_[child].size() != chromosome_pair_count)
+            throw runtime_error("[Population::MatingEngine] Parents chromosome counts differ from child.");
+
+        const ChromosomePair* p_mom = moms_[child].begin();
+        const ChromosomePair* p_dad = dads_[child].begin();
+        vector<unsigned int>* positions = &positions_[child * chromosome_pair_count * 2];
+
+        for (size_t i=0; i<chromosome_pair_count; ++i, ++p_mom, ++p_dad, positions+=2)
+        {
+            draw_positions(recombination_position_generators_, i, positions);
+
+            make_shareable(*p_mom, positions[0]);
+            make_shareable(*p_dad, positions[1]);
+        }
+    }
+
+    static void make_shareable(const ChromosomePair& parent, const vector<unsigned int>& positions)
+    {
+        if (const Chromosome* source = Chromosome::nonrecombinant_source(parent.first, parent.second, positions))
+            source->haplotype_chunks().make_shareable();
+    }
+
+    void work(size_t worker)
+    {
+        while (true)
+        {
+            barrier_.wait(); // start of block, or finished
+            if (finished_) return;
+            build_slice(worker);
+            barrier_.wait(); // end of block
+        }
+    }
+
+    void stop(boost::thread_group& workers)
+    {
+        finished_ = true;
+        barrier_.wait();
+        workers.join_all();
+    }
+
+    void build_slice(size_t worker)
+    {
+        const size_t begin = block_count_ * worker / thread_count_;
+        const size_t end = block_count_ * (worker + 1) / thread_count_;
+        const size_t stride = population_.chromosome_pair_count() * 2;
+
+        try
+        {
+            for (size_t i=begin; i<end; ++i)
+                population_.worker_chromosome_pair_range(block_begin_ + i, worker).create_child(
+                    moms_[i], dads_[i], &positions_[i * stride]);
+        }
+        catch (exception& e)
+        {
+            boost::mutex::scoped_lock lock(error_mutex_);
+            if (error_.empty()) error_ = e.what();
+        }
+    }
+};
+
+
+
 } // namespace
 
 
 void Population::create_organisms(const Config& config,
                                   const PopulationPtrs& populations,
                                   const PopulationDataPtrs& population_datas,
-                                  const RecombinationPositionGeneratorPtrs& recombination_position_generators)
+                                  const RecombinationPositionGeneratorPtrs& recombination_position_generators,
+                                  const MatingOptions& options)
 {
+    if (options.thread_count == 0)
+        throw runtime_error("[Population::create_organisms()] Thread count must be positive.");
+
     if (config.population_size == 0)
+    {
+        population_size_ = chromosome_pair_count_ = 0; // in case this Population is recycled
         return;
+    }
 
     // sanity check: chromosome_pair_count must be specified
 
@@ -652,35 +1023,45 @@ void Population::create_organisms(const Config& config,
 
     config.mating_distribution.validate_entries(population_datas);
 
-    // instantiate RandomOrganismIndexGeneratorMap
+    // instantiate RandomOrganismIndexGeneratorMap, and resolve entries to generators
 
     RandomOrganismIndexGeneratorMap generator_map(population_datas,
-        config.mating_distribution.default_fitness_function);
+        config.mating_distribution.default_fitness_function, 
+        options.parent_sampler == ParentSampler_Alias ? &alias_tables_ : 0);
+
+    MatingTable mating_table(config.mating_distribution, generator_map, 
+                             config.population_size, options.offspring_allocation);
 
     // create Organisms for new population
 
+    if (options.thread_count > 1)
+    {
+        MatingEngine engine(*this, populations, recombination_position_generators, options.thread_count);
+        engine.create_children(mating_table);
+        return;
+    }
+
+    if (recombination_position_generators.size() != 2)
+        throw runtime_error("[Population::create_organisms()] Recombination position generator count != 2.");
+
+    vector< vector<unsigned int> > positions(chromosome_pair_count() * 2); // [chromosome pair][mom/dad], reused
+
     ChromosomePairRangeIterator range_child = begin();
 
     for (size_t i=0; i<config.population_size; ++i, ++range_child)
     {
-        const MatingDistribution::Entry& entry = config.mating_distribution.random();
-
-        const RandomOrganismIndexGenerator& generator_mom = 
-            *generator_map.get(entry.first, entry.first_fitness);
+        const Mating mating = mating_table.next();
 
-        const RandomOrganismIndexGenerator& generator_dad = 
-            *generator_map.get(entry.second, entry.second_fitness);
+        const ChromosomePairRange range_mom = populations[mating.population_mom]->chromosome_pair_range(mating.index_mom);
+        const ChromosomePairRange range_dad = populations[mating.population_dad]->chromosome_pair_range(mating.index_dad);
 
-        size_t index_mom = generator_mom();
-        size_t index_dad = 0;
-        do { // avoid selfing
-            index_dad = generator_dad();
-        } while (entry.first == entry.second && index_mom == index_dad);
+        if (range_mom.size() != positions.size()/2)
+            throw runtime_error("[Population::create_organisms()] Parents chromosome counts differ from child.");
 
-        const ChromosomePairRange range_mom = populations[entry.first]->chromosome_pair_range(index_mom);
-        const ChromosomePairRange range_dad = populations[entry.second]->chromosome_pair_range(index_dad);
+        for (size_t j=0; j<range_mom.size(); ++j)
+            draw_positions(recombination_position_generators, j, &positions[j*2]);
         
-        range_child->create_child(range_mom, range_dad, recombination_position_generators);
+        range_child->create_child(range_mom, range_dad, &positions[0]);
     }
 }
 
@@ -689,14 +1070,22 @@ void Population::create_organisms(const Config& config,
 PopulationPtrsPtr Population::create_populations(const Population::Configs& configs,
                                                  const PopulationPtrs& previous, 
                                                  const PopulationDataPtrs& population_datas,
-                                                 const RecombinationPositionGeneratorPtrs& recombination_position_generators)
+                                                 const RecombinationPositionGeneratorPtrs& recombination_position_generators,
+                                                 const PopulationPtrs& spare,
+                                                 const MatingOptions& options)
 {
     PopulationPtrsPtr result(new PopulationPtrs);
+    PopulationPtrs::const_iterator spare_it = spare.begin();
 
     for (vector<Population::Config>::const_iterator it=configs.begin(); it!=configs.end(); ++it)
     {
-        PopulationPtr p(new Population_ChromosomePairs);
-        p->create_organisms(*it, previous, population_datas, recombination_position_generators);
+        // skip spares held elsewhere (or passed as previous too)
+        while (spare_it != spare.end() && (spare_it->use_count() != 1 || 
+               find(previous.begin(), previous.end(), *spare_it) != previous.end()))
+            ++spare_it;
+
+        PopulationPtr p = (spare_it != spare.end()) ? *spare_it++ : PopulationPtr(new Population_ChromosomePairs);
+        p->create_organisms(*it, previous, population_datas, recombination_position_generators, options);
         result->push_back(p);
     }        
 
@@ -40,6 +40,7 @@
 #include "DataVector.hpp"
 #include "PopulationData.hpp"
 #include "ChromosomePairRange.hpp"
+#include "Random.hpp"
 #include "shared_ptr.hpp"
 #include <vector>
 
@@ -81,6 +82,7 @@ class MatingDistribution
 
     void validate_entries(const PopulationDataPtrs& population_datas) const;
     const Entry& random() const;
+    size_t random_index() const; // index of random() in entries()
 
     private:
 
@@ -138,17 +140,47 @@ class Population
     void read_binary(std::istream& is);
     void write_binary(std::ostream& os) const;
 
+    // method for drawing parents in proportion to fitness:  binary search in the
+    // cumulative distribution (default, reproduces earlier versions for a given 
+    // seed), or alias table with O(1) draws
+    enum ParentSampler {ParentSampler_CDF, ParentSampler_Alias};
+
+    // assignment of children to MatingDistribution entries:  an entry is drawn 
+    // for each child (default, reproduces earlier versions for a given seed), or
+    // the number of children for each entry is drawn once from the multinomial 
+    // distribution, and each entry's children are created contiguously
+    enum OffspringAllocation {OffspringAllocation_PerChild, OffspringAllocation_Multinomial};
+
+    // how create_organisms() builds children; thread_count (> 0) does not change 
+    // the result
+    struct MatingOptions
+    {
+        size_t thread_count;
+        ParentSampler parent_sampler;
+        OffspringAllocation offspring_allocation;
+
+        MatingOptions()
+        :   thread_count(1), parent_sampler(ParentSampler_CDF), 
+            offspring_allocation(OffspringAllocation_PerChild)
+        {}
+    };
+
     void create_organisms(const Config& config,
                           const PopulationPtrs& populations,
                           const PopulationDataPtrs& population_datas,
-                          const RecombinationPositionGeneratorPtrs& recombination_position_generators);
+                          const RecombinationPositionGeneratorPtrs& recombination_position_generators,
+                          const MatingOptions& options = MatingOptions());
 
-    // convenience function: creates new generation from previous by calling create_organisms() for each Population
+    // convenience function: creates new generation from previous by calling create_organisms() for each Population;
+    // populations in spare (e.g. from two generations back) that no one else holds are reused, so that 
+    // their chromosome storage is recycled
 
     static PopulationPtrsPtr create_populations(const Configs& configs,
                                                 const PopulationPtrs& previous, 
                                                 const PopulationDataPtrs& population_datas, 
-                                                const RecombinationPositionGeneratorPtrs& recombination_position_generators);
+                                                const RecombinationPositionGeneratorPtrs& recombination_position_generators,
+                                                const PopulationPtrs& spare = PopulationPtrs(),
+                                                const MatingOptions& options = MatingOptions());
 
     // implementation-dependent range iteration
 
@@ -163,6 +195,15 @@ class Population
     virtual ChromosomePairRange chromosome_pair_range(size_t organism_index) = 0;
     virtual const ChromosomePairRange chromosome_pair_range(size_t organism_index) const = 0;
 
+    // multithreaded create_organisms():  allocate_workers() is called before the
+    // workers start, and each worker creates children only in ranges obtained with 
+    // its own worker_index, so that implementations can give workers separate storage
+    virtual void allocate_workers(size_t worker_count) {}
+    virtual ChromosomePairRange worker_chromosome_pair_range(size_t organism_index, size_t worker_index)
+    {
+        return chromosome_pair_range(organism_index);
+    }
+
     virtual ~Population() {}
 
     protected:
@@ -176,6 +217,10 @@ class Population
 
     private:
 
+    // alias tables for drawing parents, kept so that a recycled Population
+    // rebuilds them without allocating
+    std::vector< shared_ptr<Random::AliasTable> > alias_tables_;
+
     // disallow copying
     Population(Population&);
     Population& operator=(Population&);
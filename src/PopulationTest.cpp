@@ -167,6 +167,8 @@ void test_MatingDistribution_validate_entries()
     for (size_t i=0; i<10; ++i)
         ++counts[md.random().first];
     unit_assert(!counts[0] && counts[1]);
+    for (size_t i=0; i<10; ++i)
+        unit_assert(md.random_index() == 1);
 
     // ff1 not valid
 
@@ -421,7 +423,7 @@ void demo_Population_mutate()
 }
 
 
-void test_Population_create()
+void test_Population_create(const Population::MatingOptions& options = Population::MatingOptions())
 {
     Population::Configs configs_gen0(2);
     configs_gen0[0].population_size = 10;
@@ -506,7 +508,9 @@ void test_Population_create()
     PopulationPtrsPtr populations_gen1 = Population::create_populations(configs_gen1,
                                                                         *populations_gen0,
                                                                         population_datas,
-                                                                        rpgs);
+                                                                        rpgs,
+                                                                        PopulationPtrs(),
+                                                                        options);
     const Population& pop_gen1 = *populations_gen1->at(0);
     if (os_) *os_ << "gen1:\n" << pop_gen1 << endl;
 
@@ -531,7 +535,9 @@ void test_Population_create()
     populations_gen1 = Population::create_populations(configs_gen1,
                                                       *populations_gen0,
                                                       population_datas,
-                                                      rpgs);
+                                                      rpgs,
+                                                      PopulationPtrs(),
+                                                      options);
 
     const Population& pop_gen1_special = *populations_gen1->at(0);
     if (os_) *os_ << "gen1 special:\n" << pop_gen1_special << endl;
@@ -551,6 +557,62 @@ void test_Population_create()
 }
 
 
+void test_Population_create_multinomial()
+{
+    if (os_) *os_ << "test_Population_create_multinomial()\n";
+
+    Population::Configs configs_gen0(2);
+    configs_gen0[0].population_size = 10;
+    configs_gen0[0].chromosome_pair_count = 1;
+    configs_gen0[1].population_size = 10;
+    configs_gen0[1].chromosome_pair_count = 1;
+    configs_gen0[1].id_offset = 100;
+
+    RecombinationPositionGeneratorPtrs rpgs;
+    rpgs.push_back(RecombinationPositionGeneratorPtr(
+        new RecombinationPositionGenerator_Trivial("rpg")));
+    rpgs.push_back(rpgs.front());
+
+    PopulationPtrsPtr populations_gen0 = Population::create_populations(configs_gen0,
+        PopulationPtrs(), PopulationDataPtrs(), rpgs);
+
+    PopulationDataPtrs population_datas;
+    population_datas.push_back(PopulationDataPtr(new PopulationData));
+    population_datas.push_back(PopulationDataPtr(new PopulationData));
+    population_datas[0]->population_size = 10;
+    population_datas[1]->population_size = 10;
+
+    // entries: pop0 x pop0 (weight 1), pop1 x pop1 (weight 3)
+
+    const size_t child_count = 4000;
+    Population::Configs configs_gen1(1);
+    configs_gen1[0].population_size = child_count;
+    configs_gen1[0].chromosome_pair_count = 1;
+    configs_gen1[0].mating_distribution.push_back(MatingDistribution::Entry(1.0, 0, 0));
+    configs_gen1[0].mating_distribution.push_back(MatingDistribution::Entry(3.0, 1, 1));
+
+    Population::MatingOptions options;
+    options.offspring_allocation = Population::OffspringAllocation_Multinomial;
+    PopulationPtrsPtr populations_gen1 = Population::create_populations(configs_gen1,
+        *populations_gen0, population_datas, rpgs, PopulationPtrs(), options);
+
+    // children of each entry are contiguous, with multinomial counts
+
+    const Population& p = *populations_gen1->at(0);
+    size_t count_pop0 = 0;
+    for (size_t i=0; i<child_count; ++i)
+    {
+        const ChromosomePair& cp = *p.chromosome_pair_range(i).begin();
+        const bool from_pop0 = cp.first.haplotype_chunks().front().id < 100;
+        unit_assert(from_pop0 == (cp.second.haplotype_chunks().front().id < 100));
+        if (from_pop0) unit_assert(i == count_pop0++); // pop0 children come first
+    }
+
+    if (os_) *os_ << "count_pop0: " << count_pop0 << endl << endl;
+    unit_assert_equal(double(count_pop0)/child_count, .25, .03);
+}
+
+
 void test()
 {
     test_MatingDistribution();
@@ -561,6 +623,12 @@ void test()
     test_Population_IO_Binary();
     demo_Population_mutate();
     test_Population_create();
+
+    Population::MatingOptions options_alias;
+    options_alias.parent_sampler = Population::ParentSampler_Alias;
+    test_Population_create(options_alias);
+
+    test_Population_create_multinomial();
 }
 
 
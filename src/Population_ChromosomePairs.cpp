@@ -61,7 +61,10 @@ Population_ChromosomePairs::Population_ChromosomePairs(const string& filename)
 
 void Population_ChromosomePairs::allocate_memory()
 {
-    chromosome_pairs_.clear();
+    chromosome_pairs_.clear(); // note: capacity is retained when Population is recycled
+    arena_.reset();
+    for (vector< shared_ptr<HaplotypeChunkArena> >::iterator it=worker_arenas_.begin(); it!=worker_arenas_.end(); ++it)
+        (*it)->reset();
     chromosome_pairs_.resize(population_size_ * chromosome_pair_count_);
 }
 
@@ -69,7 +72,7 @@ void Population_ChromosomePairs::allocate_memory()
 ChromosomePairRangeIterator Population_ChromosomePairs::begin() 
 {
     if (empty()) return ChromosomePairRangeIterator(0); 
-    return ChromosomePairRangeIterator(&chromosome_pairs_[0], chromosome_pair_count_);
+    return ChromosomePairRangeIterator(&chromosome_pairs_[0], chromosome_pair_count_, &arena_);
 }
 
 
@@ -97,7 +100,7 @@ const ChromosomePairRangeIterator Population_ChromosomePairs::end() const
 ChromosomePairRange Population_ChromosomePairs::chromosome_pair_range(size_t organism_index)
 {
     ChromosomePair* p = &chromosome_pairs_[0] + organism_index*chromosome_pair_count_;
-    return ChromosomePairRange(p, p + chromosome_pair_count_);
+    return ChromosomePairRange(p, p + chromosome_pair_count_, &arena_);
 }
 
 
@@ -108,3 +111,31 @@ const ChromosomePairRange Population_ChromosomePairs::chromosome_pair_range(size
 }
 
 
+void Population_ChromosomePairs::allocate_workers(size_t worker_count)
+{
+    while (worker_arenas_.size() + 1 < worker_count)
+        worker_arenas_.push_back(shared_ptr<HaplotypeChunkArena>(new HaplotypeChunkArena));
+}
+
+
+ChromosomePairRange Population_ChromosomePairs::worker_chromosome_pair_range(size_t organism_index, size_t worker_index)
+{
+    if (worker_index > worker_arenas_.size())
+        throw runtime_error("[Population_ChromosomePairs::worker_chromosome_pair_range()] Worker not allocated.");
+
+    HaplotypeChunkArena* arena = worker_index ? worker_arenas_[worker_index-1].get() : &arena_;
+
+    ChromosomePair* p = &chromosome_pairs_[0] + organism_index*chromosome_pair_count_;
+    return ChromosomePairRange(p, p + chromosome_pair_count_, arena);
+}
+
+
+size_t Population_ChromosomePairs::arena_size() const
+{
+    size_t result = arena_.size();
+    for (vector< shared_ptr<HaplotypeChunkArena> >::const_iterator it=worker_arenas_.begin(); it!=worker_arenas_.end(); ++it)
+        result += (*it)->size();
+    return result;
+}
+
+
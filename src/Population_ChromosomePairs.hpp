@@ -59,8 +59,19 @@ class Population_ChromosomePairs : public Population
     virtual ChromosomePairRange chromosome_pair_range(size_t organism_index);
     virtual const ChromosomePairRange chromosome_pair_range(size_t organism_index) const;
 
+    // each worker has its own arena (worker 0 uses arena())
+    virtual void allocate_workers(size_t worker_count);
+    virtual ChromosomePairRange worker_chromosome_pair_range(size_t organism_index, size_t worker_index);
+
+    // generation-scoped storage for the HaplotypeChunks of all chromosomes created
+    // by create_organisms(); reset by allocate_memory()
+    const HaplotypeChunkArena& arena() const {return arena_;}
+    size_t arena_size() const; // total over all worker arenas
+
     private:
 
+    HaplotypeChunkArena arena_;
+    std::vector< shared_ptr<HaplotypeChunkArena> > worker_arenas_; // workers 1..n-1
     ChromosomePairs chromosome_pairs_;
 };
 
@@ -148,10 +148,287 @@ void test_generated()
 }
 
 
+// crossover at a fixed position: recombinant chromosomes with two chunks
+class RecombinationPositionGenerator_Fixed : public RecombinationPositionGenerator
+{
+    public:
+
+    RecombinationPositionGenerator_Fixed(const string& id, unsigned int position)
+    :   RecombinationPositionGenerator(id), position_(position)
+    {}
+
+    virtual vector<unsigned int> get_positions(size_t chromosome_pair_index) const
+    {
+        return vector<unsigned int>(1, position_);
+    }
+
+    private:
+    unsigned int position_;
+};
+
+
+void test_arena()
+{
+    if (os_) *os_ << "test_arena()\n";
+
+    Population::Configs configs_gen0(1);
+    configs_gen0[0].population_size = 10;
+    configs_gen0[0].chromosome_pair_count = 2;
+
+    Population::Configs configs_nextgen(1);
+    configs_nextgen[0].population_size = 10;
+    configs_nextgen[0].chromosome_pair_count = 2;
+    configs_nextgen[0].mating_distribution.push_back(MatingDistribution::Entry(1, 0, 0));
+
+    RecombinationPositionGeneratorPtrs rpgs;
+    rpgs.push_back(RecombinationPositionGeneratorPtr(
+        new RecombinationPositionGenerator_Fixed("rpg", 1000)));
+    rpgs.push_back(rpgs.front());
+
+    PopulationDataPtrs population_datas;
+    population_datas.push_back(PopulationDataPtr(new PopulationData));
+    population_datas[0]->population_size = 10;
+
+    // with inline storage disabled, all recombinant chromosomes are stored in the population's arena
+
+    HaplotypeChunks::use_inline_storage(false);
+    PopulationPtrsPtr gen0 = Population::create_populations(configs_gen0, PopulationPtrs(), PopulationDataPtrs(), rpgs);
+    PopulationPtrsPtr gen1 = Population::create_populations(configs_nextgen, *gen0, population_datas, rpgs);
+    HaplotypeChunks::use_inline_storage(true);
+    if (os_) *os_ << "gen1:\n" << *gen1->front() << endl;
+
+    const Population_ChromosomePairs& p1 = dynamic_cast<const Population_ChromosomePairs&>(*gen1->front());
+
+    size_t chunk_count = 0;
+    for (ChromosomePairRangeIterator range=p1.begin(); range!=p1.end(); ++range)
+    for (const ChromosomePair* p=range->begin(); p!=range->end(); ++p)
+    {
+        unit_assert(p->first.haplotype_chunks().uses_arena());
+        unit_assert(p->second.haplotype_chunks().uses_arena());
+        chunk_count += p->first.haplotype_chunks().size() + p->second.haplotype_chunks().size();
+    }
+
+    unit_assert(p1.arena().size() == chunk_count);
+    unit_assert(chunk_count == 80);
+
+    // spare gen0 is recycled
+
+    const Population* p0 = gen0->front().get();
+    PopulationPtrsPtr gen2 = Population::create_populations(configs_nextgen, *gen1, population_datas, rpgs, *gen0);
+    unit_assert(gen2->front().get() == p0);
+    gen0.reset();
+
+    // with inline storage, two-chunk chromosomes don't use the arena
+
+    const Population_ChromosomePairs& p2 = dynamic_cast<const Population_ChromosomePairs&>(*gen2->front());
+    for (ChromosomePairRangeIterator range=p2.begin(); range!=p2.end(); ++range)
+    for (const ChromosomePair* p=range->begin(); p!=range->end(); ++p)
+    {
+        unit_assert(p->first.haplotype_chunks().uses_inline());
+        unit_assert(p->second.haplotype_chunks().uses_inline());
+    }
+    unit_assert(p2.arena().size() == 0);
+
+    // spare gen1 is held elsewhere, so gen3 must be different; without spares, populations are new
+
+    PopulationPtr held = gen1->front();
+    PopulationPtrsPtr gen3 = Population::create_populations(configs_nextgen, *gen2, population_datas, rpgs, *gen1);
+    unit_assert(gen3->front().get() != gen1->front().get());
+    unit_assert(gen3->front().get() != gen2->front().get());
+
+    held.reset();
+    PopulationPtrsPtr gen4 = Population::create_populations(configs_nextgen, *gen3, population_datas, rpgs);
+    unit_assert(gen4->front().get() != gen1->front().get());
+
+    if (os_) *os_ << endl;
+}
+
+
+void test_shared()
+{
+    if (os_) *os_ << "test_shared()\n";
+
+    Population::Config config0;
+    config0.population_size = 10;
+    config0.chromosome_pair_count = 2;
+
+    Population::Config config1(config0);
+    config1.mating_distribution.push_back(MatingDistribution::Entry(1, 0, 0));
+
+    RecombinationPositionGeneratorPtrs rpgs;
+    rpgs.push_back(RecombinationPositionGeneratorPtr(
+        new RecombinationPositionGenerator_Trivial("rpg")));
+    rpgs.push_back(rpgs.front());
+
+    PopulationDataPtrs population_datas;
+    population_datas.push_back(PopulationDataPtr(new PopulationData));
+    population_datas[0]->population_size = 10;
+
+    // non-recombinant transmission shares the parental HaplotypeChunks 
+
+    HaplotypeChunks::use_inline_storage(false);
+
+    PopulationPtrs populations;
+    populations.push_back(PopulationPtr(new Population_ChromosomePairs));
+    populations[0]->create_organisms(config0, PopulationPtrs(), PopulationDataPtrs(), rpgs);
+
+    Population_ChromosomePairs p1;
+    p1.create_organisms(config1, populations, population_datas, rpgs);
+
+    HaplotypeChunks::use_inline_storage(true);
+    if (os_) *os_ << "p1:\n" << p1 << endl;
+
+    for (ChromosomePairRangeIterator range=p1.begin(); range!=p1.end(); ++range)
+    for (const ChromosomePair* p=range->begin(); p!=range->end(); ++p)
+    {
+        unit_assert(p->first.haplotype_chunks().shared());
+        unit_assert(p->second.haplotype_chunks().shared());
+    }
+    unit_assert(p1.arena().size() == 0);
+
+    if (os_) *os_ << endl;
+}
+
+
+void test_alias_recycled()
+{
+    if (os_) *os_ << "test_alias_recycled()\n";
+
+    Population::Configs configs_gen0(1);
+    configs_gen0[0].population_size = 10;
+    configs_gen0[0].chromosome_pair_count = 1;
+
+    Population::Configs configs(configs_gen0);
+    configs[0].mating_distribution.default_fitness_function = "fitness";
+    configs[0].mating_distribution.push_back(MatingDistribution::Entry(1, 0, 0));
+
+    RecombinationPositionGeneratorPtrs rpgs;
+    rpgs.push_back(RecombinationPositionGeneratorPtr(
+        new RecombinationPositionGenerator_Trivial("rpg")));
+    rpgs.push_back(rpgs.front());
+
+    PopulationDataPtrs population_datas(1, PopulationDataPtr(new PopulationData));
+    population_datas[0]->population_size = 10;
+    DataVectorPtr fitness(new DataVector(10, 0));
+    (*fitness)[7] = 1;
+    (*fitness)[8] = 2;
+    (*population_datas[0]->trait_values)["fitness"] = fitness;
+
+    Population::MatingOptions options;
+    options.parent_sampler = Population::ParentSampler_Alias;
+
+    // all parents are organisms 7 and 8
+
+    PopulationPtrsPtr gen0 = Population::create_populations(configs_gen0, PopulationPtrs(), PopulationDataPtrs(), rpgs);
+    PopulationPtrsPtr gen1 = Population::create_populations(configs, *gen0, population_datas, rpgs, 
+                                                            PopulationPtrs(), options);
+
+    for (ChromosomePairRangeIterator range=gen1->front()->begin(); range!=gen1->front()->end(); ++range)
+    for (const ChromosomePair* p=range->begin(); p!=range->end(); ++p)
+    {
+        unit_assert(p->first.haplotype_chunks().front().id/2 == 7 || p->first.haplotype_chunks().front().id/2 == 8);
+        unit_assert(p->second.haplotype_chunks().front().id/2 == 7 || p->second.haplotype_chunks().front().id/2 == 8);
+    }
+
+    // recycled gen0 rebuilds its alias table for new fitnesses, with the same
+    // result as a new Population
+
+    (*fitness)[7] = (*fitness)[8] = 0;
+    (*fitness)[2] = 1;
+    (*fitness)[5] = 3;
+
+    const Population* p0 = gen0->front().get();
+    Random::seed(17);
+    PopulationPtrsPtr recycled = Population::create_populations(configs, *gen1, population_datas, rpgs, *gen0, options);
+    unit_assert(recycled->front().get() == p0);
+    gen0.reset();
+
+    Random::seed(17);
+    PopulationPtrsPtr fresh = Population::create_populations(configs, *gen1, population_datas, rpgs, 
+                                                             PopulationPtrs(), options);
+    unit_assert(*recycled->front() == *fresh->front());
+
+    if (os_) *os_ << endl;
+}
+
+
+PopulationPtrsPtr run_generations(size_t thread_count)
+{
+    const size_t population_size = 5000; // several MatingEngine blocks
+    const size_t chromosome_pair_count = 3;
+
+    Population::Configs configs_gen0(1);
+    configs_gen0[0].population_size = population_size;
+    configs_gen0[0].chromosome_pair_count = chromosome_pair_count;
+
+    Population::Configs configs(configs_gen0);
+    configs[0].mating_distribution.push_back(MatingDistribution::Entry(1, 0, 0));
+
+    PopulationDataPtrs population_datas(1, PopulationDataPtr(new PopulationData));
+    population_datas[0]->population_size = population_size;
+
+    vector<RecombinationPositionGenerator_Uniform::ChromosomeInfo> infos(chromosome_pair_count, 
+        RecombinationPositionGenerator_Uniform::ChromosomeInfo(1000000, 1.0));
+
+    RecombinationPositionGeneratorPtrs rpgs;
+    rpgs.push_back(RecombinationPositionGeneratorPtr(new RecombinationPositionGenerator_Uniform("rpg", infos)));
+    rpgs.push_back(rpgs.front());
+
+    Population::MatingOptions options;
+    options.thread_count = thread_count;
+    Random::seed(123);
+
+    PopulationPtrsPtr populations = Population::create_populations(configs_gen0, 
+        PopulationPtrs(), PopulationDataPtrs(), rpgs);
+
+    PopulationPtrsPtr spare(new PopulationPtrs);
+
+    for (size_t generation=0; generation<5; ++generation)
+    {
+        PopulationPtrsPtr next = Population::create_populations(configs, *populations, population_datas, rpgs, *spare, options);
+        spare = populations;
+        populations = next;
+    }
+
+    return populations;
+}
+
+
+void test_threads()
+{
+    if (os_) *os_ << "test_threads()\n";
+
+    PopulationPtrsPtr serial = run_generations(1);
+    PopulationPtrsPtr parallel = run_generations(3);
+
+    const Population_ChromosomePairs& p_serial = dynamic_cast<const Population_ChromosomePairs&>(*serial->front());
+    const Population_ChromosomePairs& p_parallel = dynamic_cast<const Population_ChromosomePairs&>(*parallel->front());
+
+    if (os_) *os_ << "arena_size: " << p_serial.arena_size() << " " << p_parallel.arena_size() << endl;
+
+    unit_assert(p_serial.population_size() == 5000);
+    unit_assert(p_serial == p_parallel);
+    unit_assert(p_serial.arena_size() == p_parallel.arena_size());
+    unit_assert(p_parallel.arena().size() < p_parallel.arena_size()); // workers have separate arenas
+
+    Population::MatingOptions options_bad;
+    options_bad.thread_count = 0;
+    Population_ChromosomePairs p;
+    unit_assert_throws(p.create_organisms(Population::Config(), PopulationPtrs(), PopulationDataPtrs(),
+                                          RecombinationPositionGeneratorPtrs(), options_bad), runtime_error);
+
+    if (os_) *os_ << endl;
+}
+
+
 void test()
 {
     test_initial();
     test_generated();
+    test_arena();
+    test_shared();
+    test_alias_recycled();
+    test_threads();
 }
 
 
@@ -390,7 +390,7 @@ void QuantitativeTrait_IndependentLoci::calculate_trait_values(const PopulationD
 
     for (QTLEffects::const_iterator it=qtl_effects_.begin(); it!=qtl_effects_.end(); ++it)
     {
-        if (!population_data.genotypes->count(it->locus))
+        if (!population_data.genotypes->contains(it->locus))
         {
             ostringstream oss;
             oss << "[QuantitativeTrait_IndependentLoci] Invalid genotype map: locus "
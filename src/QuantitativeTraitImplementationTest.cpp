@@ -243,9 +243,9 @@ void test_QuantitativeTrait_IndependentLoci()
     population_data.population_size = n;
 
     GenotypeMapPtr genotypes = population_data.genotypes;
-    (*genotypes)[*locus_1] = GenotypeDataPtr(new GenotypeData(genotypes_raw_1, genotypes_raw_1 + n));
-    (*genotypes)[*locus_2] = GenotypeDataPtr(new GenotypeData(genotypes_raw_2, genotypes_raw_2 + n));
-    (*genotypes)[*locus_3] = GenotypeDataPtr(new GenotypeData(genotypes_raw_3, genotypes_raw_3 + n));
+    genotypes->set(*locus_1, GenotypeDataPtr(new GenotypeData(genotypes_raw_1, genotypes_raw_1 + n)));
+    genotypes->set(*locus_2, GenotypeDataPtr(new GenotypeData(genotypes_raw_2, genotypes_raw_2 + n)));
+    genotypes->set(*locus_3, GenotypeDataPtr(new GenotypeData(genotypes_raw_3, genotypes_raw_3 + n)));
 
     qt.calculate_trait_values(population_data);
     DataVectorPtr trait_values = population_data.trait_values->at("id_dummy");
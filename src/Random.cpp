@@ -35,6 +35,8 @@
 
 #include "Random.hpp"
 #include "boost/random.hpp"
+#include <algorithm>
+#include <limits>
 
 
 using namespace std;
@@ -46,6 +48,22 @@ typedef boost::mt19937 Generator;
 Generator rng_; // global generator
 boost::uniform_real<> dist_01_(0, 1); // global distribution ~ Uniform(0,1)
 boost::variate_generator<boost::mt19937&, boost::uniform_real<> > random_01_(rng_, dist_01_); // glues generator to distribution for convenience:  random_01() == dist_01(rng) 
+unsigned int seed_ = 0;
+
+__thread Random::Stream* current_stream_ = 0; // bound to the calling thread by ScopedStream
+
+
+double random_01()
+{
+    return current_stream_ ? current_stream_->uniform_01() : random_01_();
+}
+
+
+template <typename distribution_type>
+typename distribution_type::result_type sample(distribution_type& dist)
+{
+    return current_stream_ ? dist(*current_stream_) : dist(rng_);
+}
 
 } // namespace
 
@@ -58,12 +76,19 @@ boost::variate_generator<boost::mt19937&, boost::uniform_real<> > random_01_(rng
 void Random::seed(unsigned int value)
 {
     rng_.seed(value);
+    seed_ = value;
+}
+
+
+unsigned int Random::seed()
+{
+    return seed_;
 }
 
 
 int Random::uniform_integer(int a, int b)
 {
-    double t = random_01_();
+    double t = random_01();
     int result = a + int(t*(b+1-a));
     if (result == b+1) throw runtime_error("[Random::uniform_integer()] This isn't happening.");
     return result;
@@ -72,7 +97,7 @@ int Random::uniform_integer(int a, int b)
 
 long Random::uniform_long(long a, long b)
 {
-    double t = random_01_();
+    double t = random_01();
     long result = a + long(t*(b+1-a));
     if (result == b+1) throw runtime_error("[Random::uniform_long()] This isn't happening.");
     return result;
@@ -81,58 +106,82 @@ long Random::uniform_long(long a, long b)
 
 double Random::uniform_real(double a, double b)
 {
-    return random_01_() * (b-a) + a;
+    return random_01() * (b-a) + a;
 }
 
 
 double Random::uniform_01()
 {
-    return random_01_();
+    return random_01();
 }
 
 
 int Random::bernoulli(double p)
 {
-    return random_01_() < p ? 1 : 0;
+    return random_01() < p ? 1 : 0;
+}
+
+
+long Random::binomial(long n, double p)
+{
+    return Binomial(n, p)();
 }
 
 
 namespace {
 
 
-vector<size_t> random_indices_without_replacement_naive(size_t population_size, size_t sample_size)
+void random_indices_without_replacement_rejection(size_t population_size, size_t sample_size,
+                                                  vector<size_t>& result)
 {
-    set<size_t> temp;
+    // Draw uniformly until sample_size distinct indices have been drawn:  cost is
+    // O(sample_size log sample_size), independent of population_size.  
+    //
+    // Each batch draws only as many indices as are still missing, and a draw
+    // adds at most one distinct index, so the draws and the result are the same
+    // as inserting one draw at a time into a std::set (the previous 
+    // implementation), without per-element allocation.
+    //
+    // In int range, uniform_long() gives the same values as uniform_integer().
+    // Beyond it, uniform_long() is unusable: random_01() has only 32 bits of
+    // resolution, so it would reach only multiples of population_size/2^32.
+    // Wide populations draw a full 64-bit integer instead.
+
+    result.clear();
+    result.reserve(sample_size);
+
+    const bool wide = population_size - 1 > size_t(numeric_limits<int>::max());
+    boost::random::uniform_int_distribution<boost::uint64_t> wide_dist(0, population_size - 1);
 
-    while (temp.size() < sample_size)
+    while (result.size() < sample_size)
     {
-        size_t index = Random::uniform_integer(0, population_size - 1);
-        if (temp.count(index)) continue;
-        temp.insert(index);
-    }
+        const size_t sorted_count = result.size();
 
-    vector<size_t> result;
-    result.reserve(temp.size());
-    copy(temp.begin(), temp.end(), back_inserter(result));
-    return result;
+        for (size_t i=sorted_count; i<sample_size; ++i)
+            result.push_back(wide ? size_t(sample(wide_dist)) :
+                                    size_t(Random::uniform_long(0, long(population_size - 1))));
+
+        sort(result.begin() + sorted_count, result.end());
+        inplace_merge(result.begin(), result.begin() + sorted_count, result.end());
+        result.erase(unique(result.begin(), result.end()), result.end());
+    }
 }
 
 
-vector<size_t> random_indices_without_replacement_knuth(size_t population_size, size_t sample_size)
+void random_indices_without_replacement_knuth(size_t population_size, size_t sample_size,
+                                              vector<size_t>& result)
 {
     // algorithm due to Knuth, via internet
 
-    vector<size_t> result(sample_size);
+    result.resize(sample_size);
 
     const size_t& N = population_size;
     const size_t& n = sample_size;
 
     for (size_t t=0, m=0; m<n; ++t)
-        if (random_01_() * (N-t) < n - m)
+        if (random_01() * (N-t) < n - m)
             result[m++] = t;
 
-    return result;
-
     //
     // Explanation:
     //
@@ -149,17 +198,230 @@ vector<size_t> random_indices_without_replacement_knuth(size_t population_size,
 
 
 vector<size_t> Random::random_indices_without_replacement(size_t population_size, size_t sample_size)
+{
+    vector<size_t> result;
+    random_indices_without_replacement(population_size, sample_size, result);
+    return result;
+}
+
+
+void Random::random_indices_without_replacement(size_t population_size, size_t sample_size,
+                                                vector<size_t>& result)
 {
     if (sample_size > population_size)
         throw runtime_error("[Random::random_indices_without_replacement()] sample_size > population_size");
 
-    // Knuth's algorithm is slower than the naive algorithm when sample_size << population_size;
-    // I haven't benchmarked -- this is an arbitrary condition.
+    // Knuth's selection sampling is O(population_size), so it is used only for dense
+    // samples, where population_size is at most 10*sample_size; sparse samples use 
+    // rejection, whose cost depends only on sample_size.
 
     if (sample_size < population_size/10.)
-        return random_indices_without_replacement_naive(population_size, sample_size);
+        random_indices_without_replacement_rejection(population_size, sample_size, result);
     else
-        return random_indices_without_replacement_knuth(population_size, sample_size);
+        random_indices_without_replacement_knuth(population_size, sample_size, result);
+}
+
+
+//
+// Random::Stream
+//
+
+
+Random::Stream::Stream(const Address& address)
+:   address_(address), block_index_(0), index_(4)
+{}
+
+
+double Random::Stream::uniform_01()
+{
+    boost::uint64_t hi = (*this)() >> 5; // 27 bits
+    boost::uint64_t lo = (*this)() >> 6; // 26 bits
+    return double((hi << 26) | lo) * (1.0 / 9007199254740992.0); // 2^53
+}
+
+
+void Random::Stream::philox(const boost::uint32_t* key, const boost::uint32_t* counter, boost::uint32_t* result)
+{
+    const boost::uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57; // multipliers
+    const boost::uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85; // Weyl sequence key increments
+
+    boost::uint32_t k0 = key[0], k1 = key[1];
+    boost::uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+
+    for (int round=0; round<10; ++round, k0+=W0, k1+=W1)
+    {
+        const boost::uint64_t p0 = boost::uint64_t(M0) * c0;
+        const boost::uint64_t p1 = boost::uint64_t(M1) * c2;
+
+        c0 = boost::uint32_t(p1 >> 32) ^ c1 ^ k0;
+        c2 = boost::uint32_t(p0 >> 32) ^ c3 ^ k1;
+        c1 = boost::uint32_t(p1);
+        c3 = boost::uint32_t(p0);
+    }
+
+    result[0] = c0; result[1] = c1; result[2] = c2; result[3] = c3;
+}
+
+
+void Random::Stream::generate_block()
+{
+    // key: (seed, generation);  counter: (block index, population, worker)
+
+    const boost::uint32_t key[] = {address_.seed, address_.generation};
+    const boost::uint32_t counter[] = {boost::uint32_t(block_index_), boost::uint32_t(block_index_ >> 32), 
+                                       address_.population, address_.worker};
+    philox(key, counter, block_);
+    ++block_index_;
+    index_ = 0;
+}
+
+
+//
+// Random::ScopedStream
+//
+
+
+Random::ScopedStream::ScopedStream(Stream& stream)
+:   previous_(current_stream_)
+{
+    current_stream_ = &stream;
+}
+
+
+Random::ScopedStream::~ScopedStream()
+{
+    current_stream_ = previous_;
+}
+
+
+//
+// Random::AliasTable
+//
+
+
+void Random::AliasTable::assign(const vector<double>& weights)
+{
+    const size_t n = weights.size();
+
+    probability_.clear();
+    alias_.clear();
+    if (n == 0) return;
+
+    if (n > 0xffffffff)
+        throw runtime_error("[Random::AliasTable] Too many weights.");
+
+    double total = 0;
+    for (vector<double>::const_iterator it=weights.begin(); it!=weights.end(); ++it)
+    {
+        if (*it < 0)
+            throw runtime_error("[Random::AliasTable] Negative weight.");
+        total += *it;
+    }
+
+    if (total <= 0)
+        throw runtime_error("[Random::AliasTable] Weights sum to 0.");
+
+    // Vose's method:  scale weights to mean 1, then pair each small (< 1) entry 
+    // with a large entry that donates the remainder of its column
+
+    probability_.resize(n);
+    alias_.resize(n);
+    small_.clear();
+    large_.clear();
+
+    for (size_t i=0; i<n; ++i)
+    {
+        probability_[i] = weights[i] * n / total;
+        alias_[i] = boost::uint32_t(i);
+        (probability_[i] < 1 ? small_ : large_).push_back(boost::uint32_t(i));
+    }
+
+    while (!small_.empty() && !large_.empty())
+    {
+        boost::uint32_t s = small_.back(); small_.pop_back();
+        boost::uint32_t l = large_.back(); large_.pop_back();
+
+        alias_[s] = l;
+        probability_[l] = (probability_[l] + probability_[s]) - 1;
+        (probability_[l] < 1 ? small_ : large_).push_back(l);
+    }
+
+    // remaining entries are 1 up to rounding error
+
+    for (vector<boost::uint32_t>::const_iterator it=small_.begin(); it!=small_.end(); ++it)
+        probability_[*it] = 1;
+    for (vector<boost::uint32_t>::const_iterator it=large_.begin(); it!=large_.end(); ++it)
+        probability_[*it] = 1;
+}
+
+
+size_t Random::AliasTable::operator()() const
+{
+    if (probability_.empty())
+        throw runtime_error("[Random::AliasTable] Empty table.");
+
+    double u = random_01() * probability_.size();
+    size_t i = min(size_t(u), probability_.size() - 1);
+    return (u - i < probability_[i]) ? i : alias_[i];
+}
+
+
+//
+// Random::Poisson
+//
+
+
+void Random::Poisson::mean(double value)
+{
+    if (value == mean_) return;
+
+    if (value < 0)
+        throw runtime_error("[Random::Poisson] Negative mean.");
+
+    mean_ = value;
+    if (mean_ > 0)
+        distribution_ = boost::random::poisson_distribution<long, double>(mean_);
+}
+
+
+long Random::Poisson::operator()() const
+{
+    if (mean_ == 0) 
+    {
+        // inversion with mean 0: consume the single uniform draw, return 0
+        boost::random::uniform_01<double> dist_01;
+        sample(dist_01);
+        return 0;
+    }
+
+    return sample(distribution_);
+}
+
+
+//
+// Random::Binomial
+//
+
+
+void Random::Binomial::parameters(long n, double p)
+{
+    if (n == n_ && p == p_) return;
+
+    if (n < 0 || p < 0 || p > 1)
+        throw runtime_error("[Random::Binomial] Bad parameters.");
+
+    n_ = n;
+    p_ = p;
+    if (n_ > 0 && p_ > 0 && p_ < 1)
+        distribution_ = boost::random::binomial_distribution<long, double>(n_, p_);
+}
+
+
+long Random::Binomial::operator()() const
+{
+    if (n_ == 0 || p_ == 0) return 0;
+    if (p_ == 1) return n_;
+    return sample(distribution_);
 }
 
 
@@ -269,7 +531,7 @@ class Distribution_UniformReal : public Random::Distribution
         initialize_distribution(); 
     }
 
-    virtual double random_value() const {return (*dist_)(rng_);}
+    virtual double random_value() const {return sample(*dist_);}
 
     // Configurable interface
 
@@ -339,7 +601,7 @@ class Distribution_Normal : public Random::Distribution
         initialize_distribution(); 
     }
 
-    virtual double random_value() const {return (*dist_)(rng_);}
+    virtual double random_value() const {return sample(*dist_);}
 
     // Configurable interface
 
@@ -414,7 +676,7 @@ class Distribution_Exponential : public Random::Distribution
         initialize_distribution(); 
     }
 
-    virtual double random_value() const {return (*dist_)(rng_);}
+    virtual double random_value() const {return sample(*dist_);}
 
     // Configurable interface
 
@@ -493,7 +755,7 @@ class Distribution_Poisson : public Random::Distribution
         initialize_distribution(); 
     }
 
-    virtual double random_value() const {return (*dist_)(rng_);}
+    virtual double random_value() const {return sample(*dist_);}
 
     // Configurable interface
 
@@ -572,7 +834,7 @@ class Distribution_Discrete : public Random::Distribution
         initialize_distribution(); 
     }
 
-    virtual double random_value() const {return values_.at((*dist_)(rng_));}
+    virtual double random_value() const {return values_.at(sample(*dist_));}
 
     // Configurable interface
 
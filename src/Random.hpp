@@ -39,6 +39,9 @@
 
 #include "Configurable.hpp"
 #include "shared_ptr.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/random/poisson_distribution.hpp"
+#include "boost/random/binomial_distribution.hpp"
 
 
 //
@@ -53,6 +56,9 @@ class Random
     // set seed
     static void seed(unsigned int value);
 
+    // return value last passed to seed(), or 0
+    static unsigned int seed();
+
     // return random integer N with a <= N <= b
     static int uniform_integer(int a, int b);
 
@@ -68,9 +74,16 @@ class Random
     // return 1 with probability p, else 0
     static int bernoulli(double p = .5);
 
+    // return number of successes in n trials with success probability p
+    static long binomial(long n, double p);
+
     // return random sample of indices without replacement
     static std::vector<size_t> random_indices_without_replacement(size_t population_size, size_t sample_size);
 
+    // same, writing the (sorted) sample into result, reusing its capacity
+    static void random_indices_without_replacement(size_t population_size, size_t sample_size, 
+                                                   std::vector<size_t>& result);
+
     // distributions
 
     class Distribution;
@@ -97,6 +110,115 @@ class Random
 
     static DistributionPtr create_neutral_frequency_distribution(const std::string& id, 
                                                                  unsigned int sample_size = 0);
+
+    // independent random number streams:  the functions above, and Distribution
+    // random_value(), draw from the default generator unless a Stream has been 
+    // bound to the calling thread with a ScopedStream (nothing in the simulator
+    // binds one yet: the default generator is used by a single thread)
+
+    class Stream;
+    class ScopedStream;
+
+    // O(1) sampling of indices in proportion to weights
+
+    class AliasTable;
+
+    // lightweight samplers for hot paths (non-virtual, no Configurable overhead)
+
+    class Poisson;
+    class Binomial;
+};
+
+
+//
+// Random::Stream
+//
+
+
+///
+/// Counter-based random number stream (Philox4x32-10, Salmon et al. 2011).
+/// A Stream is addressed by (seed, generation, population, worker); streams
+/// with different addresses are independent of each other and of the default
+/// generator, so parallel work can draw from its own stream reproducibly.
+/// Satisfies the Boost.Random UniformRandomNumberGenerator concept.
+///
+
+
+class Random::Stream
+{
+    public:
+
+    typedef boost::uint32_t result_type;
+    static const bool has_fixed_range = false;
+
+    struct Address
+    {
+        unsigned int seed;
+        unsigned int generation;
+        unsigned int population;
+        unsigned int worker;
+
+        Address(unsigned int _seed = 0, unsigned int _generation = 0,
+                unsigned int _population = 0, unsigned int _worker = 0)
+        :   seed(_seed), generation(_generation), population(_population), worker(_worker)
+        {}
+    };
+
+    Stream(const Address& address = Address());
+
+    const Address& address() const {return address_;}
+
+    // return next 32 random bits
+    result_type operator()()
+    {
+        if (index_ == 4) generate_block();
+        return block_[index_++];
+    }
+
+    // return random double in [0,1), with 53 random bits
+    double uniform_01();
+
+    static result_type min() {return 0;}
+    static result_type max() {return 0xffffffff;}
+
+    // Philox4x32-10 bijection:  key[2], counter[4] -> result[4]
+    static void philox(const boost::uint32_t* key, const boost::uint32_t* counter, boost::uint32_t* result);
+
+    private:
+
+    Address address_;
+    boost::uint64_t block_index_;
+    boost::uint32_t block_[4];
+    size_t index_;
+
+    void generate_block();
+};
+
+
+//
+// Random::ScopedStream
+//
+
+
+///
+/// binds a Stream to the calling thread for the lifetime of this object
+///
+
+
+class Random::ScopedStream
+{
+    public:
+
+    ScopedStream(Stream& stream);
+    ~ScopedStream();
+
+    private:
+
+    Stream* previous_;
+
+    // disallow copying
+    ScopedStream(const ScopedStream&);
+    ScopedStream& operator=(const ScopedStream&);
 };
 
 
@@ -133,5 +255,95 @@ class Random::Distribution : public Configurable
 };
 
 
+//
+// Random::AliasTable
+//
+
+
+///
+/// Walker/Vose alias table:  returns index i with probability weights[i]/sum(weights),
+/// using one uniform_01() value per draw.  Construction is O(n); assign() retains
+/// the buffers, so a table can be rebuilt without memory allocation.
+///
+
+
+class Random::AliasTable
+{
+    public:
+
+    AliasTable(const std::vector<double>& weights = std::vector<double>()) {assign(weights);}
+
+    void assign(const std::vector<double>& weights);
+
+    size_t size() const {return probability_.size();}
+    bool empty() const {return probability_.empty();}
+
+    size_t operator()() const;
+
+    private:
+
+    std::vector<double> probability_; // probability of keeping index i
+    std::vector<boost::uint32_t> alias_;
+    std::vector<boost::uint32_t> small_; // construction work lists
+    std::vector<boost::uint32_t> large_;
+};
+
+
+//
+// Random::Poisson, Random::Binomial
+//
+
+
+///
+/// Poisson sampler with state cached for its mean:  inversion for small means,
+/// PTRS (Hormann 1993) for large means, as in Boost.Random, so draws are the same
+/// as those of create_poisson_distribution().  Setting the mean to its current 
+/// value is free, so callers can keep one sampler for a rate that may change.
+///
+
+
+class Random::Poisson
+{
+    public:
+
+    Poisson(double mean = 1) : mean_(-1) {this->mean(mean);}
+
+    void mean(double value); // mean >= 0
+    double mean() const {return mean_;}
+
+    long operator()() const;
+
+    private:
+
+    double mean_;
+    mutable boost::random::poisson_distribution<long, double> distribution_;
+};
+
+
+///
+/// Binomial sampler with state cached for (n,p): BTRD (Hormann 1993) via Boost.Random.
+///
+
+
+class Random::Binomial
+{
+    public:
+
+    Binomial(long n = 1, double p = .5) : n_(-1), p_(-1) {parameters(n, p);}
+
+    void parameters(long n, double p); // n >= 0, 0 <= p <= 1
+    long n() const {return n_;}
+    double p() const {return p_;}
+
+    long operator()() const;
+
+    private:
+
+    long n_;
+    double p_;
+    mutable boost::random::binomial_distribution<long, double> distribution_;
+};
+
+
 #endif // _RANDOM_HPP_
 
@@ -38,6 +38,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <vector>
+#include <set>
 #include <cstring>
 #include <ctime>
 
@@ -101,6 +102,179 @@ void test_seed()
 }
 
 
+void test_stream()
+{
+    if (os_) *os_ << "test_stream()\n";
+
+    // Philox4x32-10 known-answer test (Random123 kat_vectors)
+
+    const boost::uint32_t zero[] = {0, 0, 0, 0};
+    boost::uint32_t result[4];
+    Random::Stream::philox(zero, zero, result);
+    unit_assert(result[0] == 0x6627e8d5 && result[1] == 0xe169c58d && 
+                result[2] == 0xbc57ac4c && result[3] == 0x9b00dbd8);
+
+    // streams are reproducible and distinct by address
+
+    Random::Stream a(Random::Stream::Address(420, 3, 1, 0));
+    Random::Stream b(Random::Stream::Address(420, 3, 1, 0));
+    Random::Stream c(Random::Stream::Address(420, 3, 1, 1));
+
+    size_t differences = 0;
+    for (int i=0; i<100; i++)
+    {
+        Random::Stream::result_type x = a();
+        unit_assert(x == b());
+        if (x != c()) ++differences;
+    }
+    unit_assert(differences > 90);
+
+    double sum = 0;
+    for (int i=0; i<100000; i++)
+    {
+        double x = a.uniform_01();
+        unit_assert(x >= 0 && x < 1);
+        sum += x;
+    }
+    unit_assert_equal(sum/100000, .5, .01);
+
+    // ScopedStream redirects the static functions and distributions, 
+    // without advancing the default generator
+
+    Random::seed(420);
+    unit_assert(Random::seed() == 420);
+    double expected = Random::uniform_01();
+
+    Random::DistributionPtr normal = Random::create_normal_distribution("normal");
+
+    Random::seed(420);
+    Random::Stream d(Random::Stream::Address(420, 7)), e(Random::Stream::Address(420, 7));
+    double x_scoped = 0, y_scoped = 0;
+    {
+        Random::ScopedStream scope(d);
+        x_scoped = Random::uniform_01();
+        y_scoped = normal->random_value();
+    }
+    unit_assert(Random::uniform_01() == expected);
+    unit_assert(x_scoped == e.uniform_01());
+
+    {
+        Random::ScopedStream scope(e);
+        unit_assert(normal->random_value() == y_scoped);
+    }
+
+    if (os_) *os_ << endl;
+}
+
+
+void test_alias_table()
+{
+    if (os_) *os_ << "test_alias_table()\n";
+
+    double weights_raw[] = {1, 0, 3, 6};
+    vector<double> weights(weights_raw, weights_raw + 4);
+
+    Random::seed(420);
+    Random::AliasTable table(weights);
+    unit_assert(table.size() == 4);
+
+    const size_t sample_count = 100000;
+    vector<size_t> counts(4);
+    for (size_t i=0; i<sample_count; ++i)
+        ++counts.at(table());
+
+    if (os_) copy(counts.begin(), counts.end(), ostream_iterator<size_t>(*os_, " "));
+    if (os_) *os_ << endl;
+
+    unit_assert(counts[1] == 0);
+    for (size_t i=0; i<4; ++i)
+        unit_assert_equal(double(counts[i])/sample_count, weights[i]/10, .01);
+
+    // rebuild with new weights
+
+    weights.assign(2, 1.0);
+    table.assign(weights);
+    unit_assert(table.size() == 2);
+    size_t ones = 0;
+    for (size_t i=0; i<sample_count; ++i)
+        ones += table();
+    unit_assert_equal(double(ones)/sample_count, .5, .01);
+
+    weights[0] = -1;
+    unit_assert_throws(table.assign(weights), runtime_error);
+    unit_assert_throws(table.assign(vector<double>(3, 0.0)), runtime_error);
+
+    if (os_) *os_ << endl;
+}
+
+
+void test_binomial()
+{
+    if (os_) *os_ << "test_binomial()\n";
+
+    unit_assert(Random::binomial(0, .5) == 0);
+    unit_assert(Random::binomial(10, 0) == 0);
+    unit_assert(Random::binomial(10, 1) == 10);
+    unit_assert_throws(Random::binomial(10, 1.5), runtime_error);
+
+    const size_t sample_count = 10000;
+    double sum = 0;
+    for (size_t i=0; i<sample_count; ++i)
+    {
+        long x = Random::binomial(100, .3);
+        unit_assert(x >= 0 && x <= 100);
+        sum += x;
+    }
+    if (os_) *os_ << "mean: " << sum/sample_count << endl << endl;
+    unit_assert_equal(sum/sample_count, 30, .2);
+}
+
+
+void test_poisson_sampler()
+{
+    if (os_) *os_ << "test_poisson_sampler()\n";
+
+    // same draws as the configurable Poisson distribution, for small, large, and 0 means
+
+    const double means[] = {0, .3, 4.5, 10, 123.4};
+    const size_t mean_count = sizeof(means)/sizeof(double);
+
+    for (size_t i=0; i<mean_count; ++i)
+    {
+        Random::DistributionPtr d = Random::create_poisson_distribution("id_dummy", means[i]);
+        Random::Poisson poisson(means[i]);
+
+        Random::seed(i + 1);
+        vector<double> expected;
+        for (size_t j=0; j<100; ++j)
+            expected.push_back(d->random_value());
+
+        Random::seed(i + 1);
+        for (size_t j=0; j<100; ++j)
+            unit_assert(poisson() == expected[j]);
+    }
+
+    // mean may be changed in place
+
+    Random::Poisson poisson;
+    unit_assert(poisson.mean() == 1);
+    poisson.mean(0);
+    for (size_t i=0; i<10; ++i)
+        unit_assert(poisson() == 0);
+    poisson.mean(50);
+    unit_assert(poisson.mean() == 50);
+    unit_assert_throws(poisson.mean(-1), runtime_error);
+
+    Random::Binomial binomial(10, 1);
+    unit_assert(binomial() == 10);
+    binomial.parameters(10, 0);
+    unit_assert(binomial() == 0);
+    unit_assert_throws(binomial.parameters(-1, .5), runtime_error);
+
+    if (os_) *os_ << endl;
+}
+
+
 void test_constant_distribution()
 {
     if (os_) *os_ << "test_constant_distribution()\n";
@@ -373,6 +547,69 @@ void demo_random_indices_without_replacement()
 }
 
 
+vector<size_t> random_indices_set(size_t population_size, size_t sample_size)
+{
+    set<size_t> temp;
+    while (temp.size() < sample_size)
+        temp.insert(Random::uniform_integer(0, population_size - 1));
+    return vector<size_t>(temp.begin(), temp.end());
+}
+
+
+void test_random_indices_without_replacement()
+{
+    if (os_) *os_ << "test_random_indices_without_replacement()\n";
+
+    // sparse samples match the set-based rejection sampler, draw for draw
+
+    for (size_t sample_size=1; sample_size<100; sample_size+=7)
+    {
+        Random::seed(sample_size);
+        vector<size_t> expected = random_indices_set(1000, sample_size);
+        Random::seed(sample_size);
+        unit_assert(Random::random_indices_without_replacement(1000, sample_size) == expected);
+    }
+
+    // population_size beyond int range
+
+    const size_t population_size = size_t(200000) * 1000000; // 2e11
+    vector<size_t> indices = Random::random_indices_without_replacement(population_size, 20);
+    unit_assert(indices.size() == 20);
+    for (size_t i=0; i<indices.size(); ++i)
+    {
+        unit_assert(indices[i] < population_size);
+        if (i) unit_assert(indices[i-1] < indices[i]);
+    }
+    unit_assert(indices.back() > size_t(1) << 32);
+
+    // beyond 2^32, indices are not confined to a grid of 2^32 points
+
+    const size_t wide_population_size = size_t(1) << 40;
+    const size_t grid_step = wide_population_size >> 32;
+    indices = Random::random_indices_without_replacement(wide_population_size, 100);
+    unit_assert(indices.size() == 100);
+    size_t off_grid_count = 0;
+    for (size_t i=0; i<indices.size(); ++i)
+    {
+        unit_assert(indices[i] < wide_population_size);
+        if (indices[i] % grid_step) ++off_grid_count;
+    }
+    unit_assert(off_grid_count > 0);
+
+    // dense samples
+
+    indices = Random::random_indices_without_replacement(100, 50);
+    unit_assert(indices.size() == 50);
+    for (size_t i=1; i<indices.size(); ++i)
+        unit_assert(indices[i-1] < indices[i] && indices[i] < 100);
+
+    unit_assert(Random::random_indices_without_replacement(10, 10).size() == 10);
+    unit_assert_throws(Random::random_indices_without_replacement(10, 11), runtime_error);
+
+    if (os_) *os_ << endl;
+}
+
+
 void test_discrete_distribution() 
 {
     if (os_) *os_ << "test_discrete_distribution()\n";
@@ -547,7 +784,12 @@ void test_neutral_frequency_distribution()
 void test()
 {
     demo();
-    test_seed();
+    test_stream();
+    test_alias_table();
+    test_binomial();
+    test_poisson_sampler();
+    test_random_indices_without_replacement();
+    test_seed(); // reseeds, so later tests see the same random sequence as before
     test_constant_distribution();
     test_uniform_real_distribution();
     test_normal_distribution();
@@ -35,14 +35,21 @@
 
 #include "RecombinationMap.hpp"
 #include "Random.hpp"
+#include "boost/interprocess/file_mapping.hpp"
+#include "boost/interprocess/mapped_region.hpp"
+#include "boost/cstdint.hpp"
 #include <iostream>
 #include <fstream>
 #include <iterator>
+#include <algorithm>
 #include <stdexcept>
+#include <cstring>
 #include <cmath>
 
 
 using namespace std;
+using boost::uint32_t;
+using boost::uint64_t;
 
 
 namespace {
@@ -54,10 +61,116 @@ unsigned int factorial(unsigned int n)
     return result;
 }
 
+
+//
+// binary map format (native byte order):
+//     BinaryHeader
+//     uint32_t positions[record_count]
+//     (padding to 8-byte alignment)
+//     double genetic_map[record_count]
+//     uint32_t guide[record_count]
+//
+
+const char binary_magic_[8] = {'f', 'o', 'r', 'q', 's', 'm', 'a', 'p'};
+const uint32_t binary_version_ = 1;
+const uint32_t binary_byte_order_ = 0x01020304;
+
+struct BinaryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t record_count;
+    double guide_scale;
+};
+
+size_t genetic_map_offset(size_t record_count)
+{
+    size_t offset = sizeof(BinaryHeader) + record_count * sizeof(uint32_t);
+    return (offset + 7) / 8 * 8;
+}
+
+size_t guide_offset(size_t record_count)
+{
+    return genetic_map_offset(record_count) + record_count * sizeof(double);
+}
+
+size_t binary_size(size_t record_count)
+{
+    return guide_offset(record_count) + record_count * sizeof(uint32_t);
+}
+
 } // namespace
 
 
 RecombinationMap::RecombinationMap(const string& filename)
+:   record_count_(0), positions_(0), genetic_map_(0), guide_(0), guide_scale_(0)
+{
+    if (is_binary(filename))
+        read_binary(filename);
+    else
+        read_text(filename);
+}
+
+
+RecombinationMap::RecombinationMap(const Records& records)
+:   records_(records),
+    record_count_(0), positions_(0), genetic_map_(0), guide_(0), guide_scale_(0)
+{
+    if (records_.empty())
+        throw runtime_error("[RecombinationMap] No records.");
+
+    compile();
+}
+
+
+RecombinationMap::Records RecombinationMap::records() const
+{
+    if (!records_.empty())
+        return records_;
+
+    Records result;
+    result.reserve(record_count_);
+    for (size_t i=0; i<record_count_; ++i)
+        result.push_back(Record(positions_[i], 0, genetic_map_[i]));
+    return result;
+}
+
+
+bool RecombinationMap::is_binary(const string& filename)
+{
+    ifstream is(filename.c_str(), ios::binary);
+    char magic[sizeof(binary_magic_)];
+    if (!is.read(magic, sizeof(magic))) return false;
+    return !memcmp(magic, binary_magic_, sizeof(magic));
+}
+
+
+void RecombinationMap::write_binary(ostream& os) const
+{
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, binary_magic_, sizeof(binary_magic_));
+    header.version = binary_version_;
+    header.byte_order = binary_byte_order_;
+    header.record_count = record_count_;
+    header.guide_scale = guide_scale_;
+
+    const char padding[8] = {0};
+    const size_t padding_size = genetic_map_offset(record_count_) - sizeof(header) - record_count_ * sizeof(uint32_t);
+
+    os.write((const char*)&header, sizeof(header));
+    os.write((const char*)positions_, record_count_ * sizeof(uint32_t));
+    os.write(padding, padding_size);
+    os.write((const char*)genetic_map_, record_count_ * sizeof(double));
+    os.write((const char*)guide_, record_count_ * sizeof(uint32_t));
+
+    if (!os)
+        throw runtime_error("[RecombinationMap::write_binary()] Error writing binary map.");
+}
+
+
+void RecombinationMap::read_text(const string& filename)
 {
     // read in data file
     ifstream is(filename.c_str());
@@ -69,55 +182,163 @@ RecombinationMap::RecombinationMap(const string& filename)
     if (records_.empty())
         throw runtime_error(("[RecombinationMap] Error reading file " + filename).c_str());
 
-    // calculate Poisson distribution for number of recombination events
-    // rate == cumulative geneticMap probability == expected # of events
-    double rate = records_.back().geneticMap * .01; // cM * .01 = probability
-    double total = 0;
-    for (unsigned int i=0; i<10; i++)
-    {     
-        total += exp(-rate)*pow(rate, double(i))/factorial(i);
-        recombinationEventDistribution_.push_back(total);
+    compile();
+}
+
+
+void RecombinationMap::read_binary(const string& filename)
+{
+    namespace bip = boost::interprocess;
+
+    shared_ptr<bip::mapped_region> region;
+
+    try
+    {
+        bip::file_mapping mapping(filename.c_str(), bip::read_only);
+        region = shared_ptr<bip::mapped_region>(new bip::mapped_region(mapping, bip::read_only));
     }
+    catch (bip::interprocess_exception& e)
+    {
+        throw runtime_error(("[RecombinationMap] Unable to map file " + filename + ": " + e.what()).c_str());
+    }
+
+    const char* begin = (const char*)region->get_address();
+    const size_t size = region->get_size();
+
+    if (size < sizeof(BinaryHeader))
+        throw runtime_error(("[RecombinationMap] Truncated binary map " + filename).c_str());
+
+    const BinaryHeader& header = *(const BinaryHeader*)begin;
+
+    if (header.byte_order != binary_byte_order_ || header.version != binary_version_)
+        throw runtime_error(("[RecombinationMap] Unsupported binary map version or byte order: " + filename).c_str());
+
+    record_count_ = header.record_count;
+
+    if (record_count_ == 0 || size != binary_size(record_count_))
+        throw runtime_error(("[RecombinationMap] Bad binary map size: " + filename).c_str());
+
+    positions_ = (const unsigned int*)(begin + sizeof(BinaryHeader));
+    genetic_map_ = (const double*)(begin + genetic_map_offset(record_count_));
+    guide_ = (const unsigned int*)(begin + guide_offset(record_count_));
+    guide_scale_ = header.guide_scale;
+    mapped_region_ = region;
+
+    validate("binary map " + filename);
+    initialize_event_distribution();
 }
 
 
-namespace {
+void RecombinationMap::compile()
+{
+    // flatten the fields used for sampling
+
+    record_count_ = records_.size();
+
+    genetic_map_storage_.resize(record_count_);
+    positions_storage_.resize(record_count_);
+    for (size_t i=0; i<record_count_; ++i)
+    {
+        genetic_map_storage_[i] = records_[i].geneticMap;
+        positions_storage_[i] = records_[i].position;
+    }
+
+    // guide table: one bucket per record, equal widths in cM
+
+    const double max = genetic_map_storage_.back();
+    guide_scale_ = max > 0 ? record_count_ / max : 0;
+
+    guide_storage_.assign(record_count_, 0);
+    size_t index = 0;
+    for (size_t k=0; k<record_count_ && guide_scale_>0; ++k)
+    {
+        const double threshold = k / guide_scale_;
+        while (index < record_count_ && genetic_map_storage_[index] < threshold) ++index;
+        guide_storage_[k] = index;
+    }
 
-struct HasLowerGeneticMap
+    positions_ = &positions_storage_[0];
+    genetic_map_ = &genetic_map_storage_[0];
+    guide_ = &guide_storage_[0];
+
+    validate("records");
+    initialize_event_distribution();
+}
+
+
+void RecombinationMap::validate(const string& source) const
 {
-    bool operator()(const RecombinationMap::Record& a, const RecombinationMap::Record& b)
+    // random_position() relies on sorted records and guide entries within 
+    // [0, record_count_];  a binary map is not parsed, so a corrupt file would 
+    // otherwise be read out of bounds
+
+    for (size_t i=0; i<record_count_; ++i)
     {
-        return a.geneticMap < b.geneticMap;
+        if (guide_[i] > record_count_)
+            throw runtime_error(("[RecombinationMap] Guide table entry out of range in " + source).c_str());
+
+        if (i > 0 && positions_[i-1] > positions_[i])
+            throw runtime_error(("[RecombinationMap] Positions not sorted in " + source).c_str());
+
+        if (i > 0 && !(genetic_map_[i-1] <= genetic_map_[i])) // also rejects NaN
+            throw runtime_error(("[RecombinationMap] Genetic map (cM) not sorted in " + source).c_str());
     }
-};
 
-} // namespace
+    if (record_count_ && (!(guide_scale_ >= 0) || !(guide_scale_ * genetic_map_[record_count_-1] <= record_count_ + 1)))
+        throw runtime_error(("[RecombinationMap] Bad guide table scale in " + source).c_str());
+}
 
 
-unsigned int RecombinationMap::random_position()
+void RecombinationMap::initialize_event_distribution()
 {
-    // roll randomly into the distribution, using binary search
+    // calculate Poisson distribution for number of recombination events
+    // rate == cumulative geneticMap probability == expected # of events
+    double rate = genetic_map_[record_count_-1] * .01; // cM * .01 = probability
+    double total = 0;
+    for (unsigned int i=0; i<10; i++)
+    {     
+        total += exp(-rate)*pow(rate, double(i))/factorial(i);
+        recombinationEventDistribution_.push_back(total);
+    }
+}
+
 
-    double max = records_.back().geneticMap;
+unsigned int RecombinationMap::random_position() const
+{
+    // roll randomly into the distribution:  find the first record with 
+    // genetic_map_ >= roll (as lower_bound() would), starting from the guide table
+
+    const size_t record_count = record_count_;
+    double max = genetic_map_[record_count-1];
     double roll = Random::uniform_real(0, max);
 
-    Records::const_iterator it = lower_bound(records_.begin(), records_.end(),
-                                             Record(0, 0, roll), HasLowerGeneticMap());
+    size_t i = guide_[min(size_t(roll * guide_scale_), record_count - 1)];
+
+    while (i > 0 && genetic_map_[i-1] >= roll) --i; // guard against rounding in the bucket index
+    while (i < record_count && genetic_map_[i] < roll) ++i;
 
-    if (it == records_.begin() || it == records_.end())
+    if (i == 0 || i == record_count)
         throw runtime_error("[RecombinationMap::random_position()] This isn't happening.");
 
     // pick a position uniformly between two map positions
 
-    unsigned int range_begin = (it-1)->position;
-    unsigned int range_end = it->position - 1;
+    unsigned int range_begin = positions_[i-1];
+    unsigned int range_end = positions_[i] - 1;
     unsigned int result = Random::uniform_integer(range_begin, range_end);
 
     return result;
 }
 
 
-vector<unsigned int> RecombinationMap::random_positions()
+vector<unsigned int> RecombinationMap::random_positions() const
+{
+    vector<unsigned int> result;
+    random_positions(result);
+    return result;
+}
+
+
+void RecombinationMap::random_positions(vector<unsigned int>& result) const
 {
     // random number of events, according to recombinationEventDistribution_
 
@@ -129,10 +350,13 @@ vector<unsigned int> RecombinationMap::random_positions()
 
     // pick random positions
 
-    vector<unsigned int> result;
+    const size_t begin = result.size();
+
     for (size_t i=0; i<count; i++)
-        result.push_back(random_position());
-    return result;
+    {
+        const unsigned int position = random_position();
+        result.insert(upper_bound(result.begin() + begin, result.end(), position), position);
+    }
 }
 
 
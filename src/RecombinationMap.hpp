@@ -37,15 +37,36 @@
 #define _RECOMBINATIONMAP_HPP_
 
 
+#include "shared_ptr.hpp"
 #include <vector>
 #include <string>
-
+#include <iosfwd>
+
+
+///
+/// genetic map, compiled for sampling crossover positions:
+///   - the crossover interval is found by inversion of the cumulative genetic map,
+///     using a guide table (Chen & Asau 1974) to start the search at most a few
+///     records before the answer: O(1) expected instead of a binary search
+///   - positions from random_positions() are sorted, as expected by Chromosome
+///   - sampling is const and keeps no state outside the map, so one map may be
+///     shared by threads; draws come from the Random default generator (or from
+///     a Random::Stream bound with ScopedStream, which the simulator does not
+///     do: MatingEngine makes all draws on one thread)
+///
+/// Draws are the same as for a binary search over the records.
+///
+/// The compiled map (positions, cumulative cM, guide table) can be saved with
+/// write_binary() (forqs_aux txt2map).  Binary map files are memory-mapped 
+/// read-only, so processes using the same file share its pages, and no parsing
+/// is needed at startup.
+///
 
 class RecombinationMap
 {
     public:
 
-    // construct with filename "genetic_map_..."
+    // construct with filename "genetic_map_..." (HapMap text format), or a binary map
     RecombinationMap(const std::string& filename);
 
     //
@@ -68,17 +89,50 @@ class RecombinationMap
     };
     
     typedef std::vector<Record> Records;
-    Records records() const {return records_;}    
+    Records records() const; // combinedRate is 0 for binary maps
+
+    // construct from records (sorted by position)
+    RecombinationMap(const Records& records);
 
     // return a single random position
-    unsigned int random_position();
+    unsigned int random_position() const;
+
+    // return multiple random positions (sorted)
+    std::vector<unsigned int> random_positions() const;
 
-    // return multiple random positions
-    std::vector<unsigned int> random_positions();
+    // append multiple random positions (sorted, same draws as random_positions())
+    void random_positions(std::vector<unsigned int>& result) const;
+
+    // binary map format
+    void write_binary(std::ostream& os) const;
+    static bool is_binary(const std::string& filename);
 
     private:
-    Records records_;
+
+    Records records_; // empty for binary maps
     std::vector<double> recombinationEventDistribution_;
+
+    // compiled map: arrays point into the vectors below, or into the mapped file
+    size_t record_count_;
+    const unsigned int* positions_;
+    const double* genetic_map_; // cumulative cM
+    const unsigned int* guide_; // guide_[k]: first record with genetic_map_ >= k / guide_scale_
+    double guide_scale_; // buckets per cM
+
+    std::vector<unsigned int> positions_storage_;
+    std::vector<double> genetic_map_storage_;
+    std::vector<unsigned int> guide_storage_;
+    shared_ptr<void> mapped_region_;
+
+    void read_text(const std::string& filename);
+    void read_binary(const std::string& filename);
+    void compile();
+    void validate(const std::string& source) const; // throws unless the compiled map is usable
+    void initialize_event_distribution();
+
+    // noncopyable (arrays may point into own storage)
+    RecombinationMap(const RecombinationMap&);
+    RecombinationMap& operator=(const RecombinationMap&);
 };
 
 
@@ -34,9 +34,13 @@
 
 
 #include "RecombinationMap.hpp"
+#include "Random.hpp"
 #include "unit.hpp"
 #include <iostream>
 #include <iterator>
+#include "boost/filesystem.hpp"
+#include <algorithm>
+#include <fstream>
 #include <cstring>
 
 
@@ -46,6 +50,45 @@ using namespace std;
 ostream* os_ = 0;
 
 
+struct HasLowerGeneticMap
+{
+    bool operator()(const RecombinationMap::Record& a, const RecombinationMap::Record& b)
+    {
+        return a.geneticMap < b.geneticMap;
+    }
+};
+
+
+// reference implementation: binary search over the records
+
+unsigned int random_position_binary_search(const RecombinationMap::Records& records)
+{
+    double roll = Random::uniform_real(0, records.back().geneticMap);
+
+    RecombinationMap::Records::const_iterator it = lower_bound(records.begin(), records.end(),
+        RecombinationMap::Record(0, 0, roll), HasLowerGeneticMap());
+
+    unit_assert(it != records.begin() && it != records.end());
+
+    return Random::uniform_integer((it-1)->position, it->position - 1);
+}
+
+
+void test_random_position(const RecombinationMap& r)
+{
+    const RecombinationMap::Records records = r.records();
+
+    Random::seed(123);
+    vector<unsigned int> expected;
+    for (size_t i=0; i<10000; ++i)
+        expected.push_back(random_position_binary_search(records));
+
+    Random::seed(123);
+    for (size_t i=0; i<10000; ++i)
+        unit_assert(r.random_position() == expected[i]);
+}
+
+
 void test()
 {
     RecombinationMap r("../examples/genetic_map_chr21_b36.txt");
@@ -61,6 +104,102 @@ void test()
             *os_ << endl;
         }
     }
+
+    // guide table gives the same positions as binary search
+
+    test_random_position(r);
+
+    // small map, with an interval of zero genetic length
+
+    RecombinationMap::Records records;
+    records.push_back(RecombinationMap::Record(100, 0, 0));
+    records.push_back(RecombinationMap::Record(200, 0, 20));
+    records.push_back(RecombinationMap::Record(300, 0, 20));
+    records.push_back(RecombinationMap::Record(400, 0, 150));
+    records.push_back(RecombinationMap::Record(500, 0, 151));
+    RecombinationMap small(records);
+    test_random_position(small);
+
+    // binary map: same records and draws
+
+    const string filename_binary = "RecombinationMapTest.temp.map";
+    {
+        ofstream os(filename_binary.c_str(), ios::binary);
+        r.write_binary(os);
+    }
+
+    unit_assert(RecombinationMap::is_binary(filename_binary));
+    unit_assert(!RecombinationMap::is_binary("../examples/genetic_map_chr21_b36.txt"));
+
+    {
+        RecombinationMap r_binary(filename_binary);
+
+        const RecombinationMap::Records records = r.records();
+        const RecombinationMap::Records records_binary = r_binary.records();
+        unit_assert(records_binary.size() == records.size());
+        for (size_t i=0; i<records.size(); ++i)
+        {
+            unit_assert(records_binary[i].position == records[i].position);
+            unit_assert(records_binary[i].geneticMap == records[i].geneticMap);
+        }
+
+        test_random_position(r_binary);
+
+        Random::seed(123);
+        vector<unsigned int> expected;
+        for (size_t i=0; i<100; ++i) r.random_positions(expected);
+
+        Random::seed(123);
+        vector<unsigned int> positions;
+        for (size_t i=0; i<100; ++i) r_binary.random_positions(positions);
+
+        unit_assert(positions == expected);
+    }
+
+    // corrupt files: guide table entry out of range, genetic map not sorted
+    // (the guide table is last, preceded by the genetic map)
+
+    {
+        ifstream is(filename_binary.c_str(), ios::binary);
+        const string good((istreambuf_iterator<char>(is)), istreambuf_iterator<char>());
+        const size_t record_count = r.records().size();
+        const size_t guide_offset = good.size() - record_count * sizeof(boost::uint32_t);
+
+        string bad(good);
+        const boost::uint32_t guide_bad = boost::uint32_t(record_count + 1);
+        memcpy(&bad[guide_offset], &guide_bad, sizeof(guide_bad));
+        ofstream(filename_binary.c_str(), ios::binary).write(bad.data(), bad.size());
+        unit_assert_throws(RecombinationMap(filename_binary.c_str()), runtime_error);
+
+        bad = good;
+        const double cm_bad = -1;
+        memcpy(&bad[guide_offset - sizeof(double)], &cm_bad, sizeof(cm_bad));
+        ofstream(filename_binary.c_str(), ios::binary).write(bad.data(), bad.size());
+        unit_assert_throws(RecombinationMap(filename_binary.c_str()), runtime_error);
+
+        ofstream(filename_binary.c_str(), ios::binary).write(good.data(), good.size());
+        RecombinationMap r_good(filename_binary); // ok
+    }
+
+    // truncated file
+
+    boost::filesystem::resize_file(filename_binary, boost::filesystem::file_size(filename_binary) - 4);
+    unit_assert_throws(RecombinationMap(filename_binary.c_str()), runtime_error);
+
+    boost::filesystem::remove(filename_binary);
+
+    // random_positions() are sorted
+
+    for (size_t i=0; i<1000; ++i)
+    {
+        vector<unsigned int> positions(1, 7);
+        small.random_positions(positions);
+        unit_assert(positions[0] == 7); // appended
+        for (size_t j=2; j<positions.size(); ++j)
+            unit_assert(positions[j-1] <= positions[j]);
+        for (size_t j=1; j<positions.size(); ++j)
+            unit_assert(positions[j] >= 100 && positions[j] < 500 && !(positions[j] >= 200 && positions[j] < 300));
+    }
 }
 
 
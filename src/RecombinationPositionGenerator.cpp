@@ -47,6 +47,25 @@ using namespace std;
 //
 
 
+void RecombinationPositionGenerator::append_positions(size_t chromosome_pair_index, 
+                                                      vector<unsigned int>& positions) const
+{
+    vector<unsigned int> result = get_positions(chromosome_pair_index);
+    positions.insert(positions.end(), result.begin(), result.end());
+}
+
+
+void RecombinationPositionGenerator::get_gamete_positions(size_t chromosome_pair_count, 
+                                                          vector<unsigned int>* positions) const
+{
+    for (size_t i=0; i<chromosome_pair_count; ++i)
+    {
+        positions[i].clear();
+        append_positions(i, positions[i]);
+    }
+}
+
+
 std::string RecombinationPositionGenerator::class_name() const
 {
     cerr << "[RecombinationPositionGenerator] Warning: virtual class_name() has not been defined in derived class.\n";
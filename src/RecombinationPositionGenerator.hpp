@@ -55,6 +55,16 @@ class RecombinationPositionGenerator : public Configurable
     public:
 
     virtual std::vector<unsigned int> get_positions(size_t chromosome_pair_index = 0) const = 0;
+
+    // appends the same (sorted) positions to a caller-owned buffer, so that callers
+    // can reuse its capacity; default implementation copies from get_positions()
+    virtual void append_positions(size_t chromosome_pair_index, std::vector<unsigned int>& positions) const;
+
+    // positions for all chromosomes of one gamete in one call: positions[i] is 
+    // cleared and filled for chromosome pair i < chromosome_pair_count, with the 
+    // same draws as append_positions() in order; default implementation calls it
+    virtual void get_gamete_positions(size_t chromosome_pair_count, std::vector<unsigned int>* positions) const;
+
     virtual ~RecombinationPositionGenerator(){}
 
     // Configurable interface
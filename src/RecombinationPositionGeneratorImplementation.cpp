@@ -36,11 +36,30 @@
 #include "RecombinationPositionGeneratorImplementation.hpp"
 #include "Simulator.hpp"
 #include <stdexcept>
+#include <algorithm>
 
 
 using namespace std;
 
 
+namespace {
+
+// get_gamete_positions() for a concrete generator type, without virtual calls per chromosome
+
+template <typename RPG>
+void get_gamete_positions_nonvirtual(const RPG& rpg, size_t chromosome_pair_count, 
+                                     vector<unsigned int>* positions)
+{
+    for (size_t i=0; i<chromosome_pair_count; ++i)
+    {
+        positions[i].clear();
+        rpg.RPG::append_positions(i, positions[i]);
+    }
+}
+
+} // namespace
+
+
 //
 // RecombinationPositionGenerator_Trivial
 //
@@ -49,11 +68,25 @@ using namespace std;
 vector<unsigned int> RecombinationPositionGenerator_Trivial::get_positions(size_t chromosome_pair_index) const
 {
     vector<unsigned int> result;
-    if (Random::uniform_01()>=.5) result.push_back(0); // start with 2nd chromosome
+    append_positions(chromosome_pair_index, result);
     return result;
 }
 
 
+void RecombinationPositionGenerator_Trivial::append_positions(size_t chromosome_pair_index, 
+                                                              vector<unsigned int>& positions) const
+{
+    if (Random::uniform_01()>=.5) positions.push_back(0); // start with 2nd chromosome
+}
+
+
+void RecombinationPositionGenerator_Trivial::get_gamete_positions(size_t chromosome_pair_count, 
+                                                                  vector<unsigned int>* positions) const
+{
+    get_gamete_positions_nonvirtual(*this, chromosome_pair_count, positions);
+}
+
+
 Parameters RecombinationPositionGenerator_Trivial::parameters() const
 {
     return Parameters();
@@ -70,20 +103,33 @@ void RecombinationPositionGenerator_Trivial::configure(const Parameters& paramet
 
 
 vector<unsigned int> RecombinationPositionGenerator_SingleCrossover::get_positions(size_t chromosome_pair_index) const
+{
+    vector<unsigned int> result;
+    append_positions(chromosome_pair_index, result);
+    return result;
+}
+
+
+void RecombinationPositionGenerator_SingleCrossover::append_positions(size_t chromosome_pair_index, 
+                                                                      vector<unsigned int>& positions) const
 {
     if (chromosome_pair_index >= chromosome_lengths_.size())
         throw runtime_error("[RecombinationPositionGenerator_SingleCrossover] Invalid chromosome_pair_index.");
 
     unsigned int chromosome_length = chromosome_lengths_[chromosome_pair_index];
 
-    vector<unsigned int> result;
-    if (Random::uniform_01()>=.5) result.push_back(0); // start with 2nd chromosome
+    if (Random::uniform_01()>=.5) positions.push_back(0); // start with 2nd chromosome
 
-    if (Random::uniform_01()>=.5) return result; // no recombination
+    if (Random::uniform_01()>=.5) return; // no recombination
 
-    result.push_back(Random::uniform_integer(0, chromosome_length));
+    positions.push_back(Random::uniform_integer(0, chromosome_length));
+}
 
-    return result;
+
+void RecombinationPositionGenerator_SingleCrossover::get_gamete_positions(size_t chromosome_pair_count, 
+                                                                          vector<unsigned int>* positions) const
+{
+    get_gamete_positions_nonvirtual(*this, chromosome_pair_count, positions);
 }
 
 
@@ -109,10 +155,8 @@ void RecombinationPositionGenerator_SingleCrossover::initialize(const SimulatorC
 
 
 RecombinationPositionGenerator_Uniform::ChromosomeInfo::ChromosomeInfo(size_t _length, double _rate)
-:   length(_length), rate(_rate)
-{
-    poisson = Random::create_poisson_distribution("", rate);
-}
+:   length(_length), rate(_rate), poisson(_rate)
+{}
 
 
 RecombinationPositionGenerator_Uniform::RecombinationPositionGenerator_Uniform(const string& id, 
@@ -124,24 +168,39 @@ RecombinationPositionGenerator_Uniform::RecombinationPositionGenerator_Uniform(c
 
 
 vector<unsigned int> RecombinationPositionGenerator_Uniform::get_positions(size_t chromosome_pair_index) const
+{
+    vector<unsigned int> result;
+    append_positions(chromosome_pair_index, result);
+    return result;
+}
+
+
+void RecombinationPositionGenerator_Uniform::append_positions(size_t chromosome_pair_index, 
+                                                              vector<unsigned int>& positions) const
 {
     if (chromosome_pair_index >= infos_.size())
         throw runtime_error("[RecombinationPositionGenerator_Uniform] Invalid chromosome_pair_index.");
 
     const ChromosomeInfo& info = infos_[chromosome_pair_index];
 
-    size_t recombination_count = (size_t)info.poisson->random_value();
-    vector<unsigned int> result;
-    result.reserve(recombination_count+1);
+    size_t recombination_count = (size_t)info.poisson();
 
-    if (Random::uniform_01()>=.5) result.push_back(0); // start with 2nd chromosome
+    if (Random::uniform_01()>=.5) positions.push_back(0); // start with 2nd chromosome
 
-    vector<size_t> positions = Random::random_indices_without_replacement(info.length, recombination_count);
+    if (recombination_count == 0) return;
 
-    for (vector<size_t>::const_iterator position=positions.begin(); position!=positions.end(); ++position)
-        if (*position) result.push_back(*position);
+    vector<size_t> indices; // local, so that const calls share no state
+    Random::random_indices_without_replacement(info.length, recombination_count, indices);
 
-    return result;
+    for (vector<size_t>::const_iterator index=indices.begin(); index!=indices.end(); ++index)
+        if (*index) positions.push_back(*index);
+}
+
+
+void RecombinationPositionGenerator_Uniform::get_gamete_positions(size_t chromosome_pair_count, 
+                                                                  vector<unsigned int>* positions) const
+{
+    get_gamete_positions_nonvirtual(*this, chromosome_pair_count, positions);
 }
 
 
@@ -229,15 +288,22 @@ void RecombinationPositionGenerator_Uniform::initialize(const SimulatorConfig& c
 
 
 vector<unsigned int> RecombinationPositionGenerator_RecombinationMap::get_positions(size_t chromosome_pair_index) const
+{
+    vector<unsigned int> result;
+    append_positions(chromosome_pair_index, result);
+    return result;
+}
+
+
+void RecombinationPositionGenerator_RecombinationMap::append_positions(size_t chromosome_pair_index, 
+                                                                       vector<unsigned int>& positions) const
 {
     if (chromosome_pair_index >= recombination_maps_.size())
         throw runtime_error("[RecombinationPositionGenerator_RecombinationMap::get_positions()] Index out of bounds.");
 
-    vector<unsigned int> positions = recombination_maps_[chromosome_pair_index]->random_positions(); // may not be sorted 
-    if (Random::uniform_01()>=.5) positions.push_back(0); // start with 2nd chromosome
-    sort(positions.begin(), positions.end());
-
-    return positions; 
+    const size_t begin = positions.size();
+    recombination_maps_[chromosome_pair_index]->random_positions(positions); // sorted
+    if (Random::uniform_01()>=.5) positions.insert(positions.begin() + begin, 0); // start with 2nd chromosome
 }
 
 
@@ -256,11 +322,18 @@ void RecombinationPositionGenerator_RecombinationMap::read_files()
     recombination_maps_.clear();
 
     for (vector<string>::const_iterator it=filenames_.begin(); it!=filenames_.end(); ++it)
-        recombination_maps_.push_back(shared_ptr<RecombinationMap>(
+        recombination_maps_.push_back(shared_ptr<const RecombinationMap>(
             new RecombinationMap(*it)));
 }
 
 
+void RecombinationPositionGenerator_RecombinationMap::get_gamete_positions(size_t chromosome_pair_count, 
+                                                                           vector<unsigned int>* positions) const
+{
+    get_gamete_positions_nonvirtual(*this, chromosome_pair_count, positions);
+}
+
+
 Parameters RecombinationPositionGenerator_RecombinationMap::parameters() const
 {
     Parameters parameters;
@@ -285,16 +358,52 @@ void RecombinationPositionGenerator_RecombinationMap::configure(const Parameters
 RecombinationPositionGenerator_Composite::RecombinationPositionGenerator_Composite(
     const string& id)
 :   RecombinationPositionGenerator(id),
-    default_rpg_(new RecombinationPositionGenerator_Trivial("id_rpg_composite_default_trivial"))
+    default_rpg_(new RecombinationPositionGenerator_Trivial("id_rpg_composite_default_trivial")),
+    single_rpg_(0)
 {}
 
 
 vector<unsigned int> RecombinationPositionGenerator_Composite::get_positions(size_t chromosome_pair_index) const
 {
-    if (rpg_map_.count(chromosome_pair_index))
-        return rpg_map_.at(chromosome_pair_index)->get_positions(chromosome_pair_index);
+    vector<unsigned int> result;
+    append_positions(chromosome_pair_index, result);
+    return result;
+}
 
-    return default_rpg_->get_positions(chromosome_pair_index);
+
+void RecombinationPositionGenerator_Composite::append_positions(size_t chromosome_pair_index, 
+                                                                vector<unsigned int>& positions) const
+{
+    rpg(chromosome_pair_index).append_positions(chromosome_pair_index, positions);
+}
+
+
+void RecombinationPositionGenerator_Composite::get_gamete_positions(size_t chromosome_pair_count, 
+                                                                    vector<unsigned int>* positions) const
+{
+    if (single_rpg_ && chromosome_pair_count <= dispatch_.size())
+    {
+        single_rpg_->get_gamete_positions(chromosome_pair_count, positions);
+        return;
+    }
+
+    for (size_t i=0; i<chromosome_pair_count; ++i)
+    {
+        positions[i].clear();
+        rpg(i).append_positions(i, positions[i]);
+    }
+}
+
+
+const RecombinationPositionGenerator& RecombinationPositionGenerator_Composite::rpg(size_t chromosome_pair_index) const
+{
+    if (chromosome_pair_index < dispatch_.size())
+        return *dispatch_[chromosome_pair_index];
+
+    // not initialized, or chromosome pair not in the population config
+
+    RPGMap::const_iterator it = rpg_map_.find(chromosome_pair_index);
+    return it!=rpg_map_.end() ? *it->second : *default_rpg_;
 }
 
 
@@ -318,6 +427,9 @@ Parameters RecombinationPositionGenerator_Composite::parameters() const
 
 void RecombinationPositionGenerator_Composite::configure(const Parameters& parameters, const Registry& registry)
 {
+    dispatch_.clear(); // compiled at initialize()
+    single_rpg_ = 0;
+
     if (parameters.count("default_recombination_position_generator"))
         default_rpg_ = registry.get<RecombinationPositionGenerator>(
             parameters.value<string>("default_recombination_position_generator"));
@@ -344,3 +456,27 @@ void RecombinationPositionGenerator_Composite::configure(const Parameters& param
 }
 
 
+void RecombinationPositionGenerator_Composite::initialize(const SimulatorConfig& config)
+{
+    // compile the dispatch table, so that no map lookup is needed per chromosome
+
+    dispatch_.clear();
+    single_rpg_ = 0;
+
+    if (!config.population_config_generator.get())
+        return;
+
+    const size_t chromosome_pair_count = config.population_config_generator->chromosome_pair_count();
+
+    for (size_t i=0; i<chromosome_pair_count; ++i)
+    {
+        RPGMap::const_iterator it = rpg_map_.find(i);
+        dispatch_.push_back(it!=rpg_map_.end() ? it->second.get() : default_rpg_.get());
+    }
+
+    if (!dispatch_.empty() && 
+        count(dispatch_.begin(), dispatch_.end(), dispatch_.front()) == ptrdiff_t(dispatch_.size()))
+        single_rpg_ = dispatch_.front();
+}
+
+
@@ -81,6 +81,8 @@ class RecombinationPositionGenerator_Trivial : public RecombinationPositionGener
     {}
 
     virtual std::vector<unsigned int> get_positions(size_t chromosome_pair_index) const;
+    virtual void append_positions(size_t chromosome_pair_index, std::vector<unsigned int>& positions) const;
+    virtual void get_gamete_positions(size_t chromosome_pair_count, std::vector<unsigned int>* positions) const;
 
     // Configurable interface
 
@@ -114,6 +116,8 @@ class RecombinationPositionGenerator_SingleCrossover : public RecombinationPosit
     {}
 
     virtual std::vector<unsigned int> get_positions(size_t chromosome_pair_index) const;
+    virtual void append_positions(size_t chromosome_pair_index, std::vector<unsigned int>& positions) const;
+    virtual void get_gamete_positions(size_t chromosome_pair_count, std::vector<unsigned int>* positions) const;
 
     // Configurable interface
 
@@ -157,7 +161,7 @@ class RecombinationPositionGenerator_Uniform : public RecombinationPositionGener
     {
         size_t length;
         double rate;
-        Random::DistributionPtr poisson;
+        Random::Poisson poisson; // recombination count
         ChromosomeInfo(size_t _length, double _rate = 1.0);
     };
 
@@ -165,6 +169,8 @@ class RecombinationPositionGenerator_Uniform : public RecombinationPositionGener
                                            std::vector<ChromosomeInfo> infos = std::vector<ChromosomeInfo>());
 
     virtual std::vector<unsigned int> get_positions(size_t chromosome_pair_index) const;
+    virtual void append_positions(size_t chromosome_pair_index, std::vector<unsigned int>& positions) const;
+    virtual void get_gamete_positions(size_t chromosome_pair_count, std::vector<unsigned int>* positions) const;
 
     // Configurable interface
 
@@ -188,7 +194,8 @@ class RecombinationPositionGenerator_Uniform : public RecombinationPositionGener
 ///
 /// generates recombination positions based on a genetic map
 ///
-/// Note: genetic map files are expected to be in the HapMap genetic_map_* format
+/// Note: genetic map files are expected to be in the HapMap genetic_map_* format,
+/// or in the binary format created by 'forqs_aux txt2map' (memory-mapped, faster to load)
 /// 
 /// parameter | default | notes
 /// ----------|---------|-------------
@@ -208,6 +215,8 @@ class RecombinationPositionGenerator_RecombinationMap : public RecombinationPosi
         const std::vector<std::string>& filenames = std::vector<std::string>());
 
     virtual std::vector<unsigned int> get_positions(size_t chromosome_pair_index) const;
+    virtual void append_positions(size_t chromosome_pair_index, std::vector<unsigned int>& positions) const;
+    virtual void get_gamete_positions(size_t chromosome_pair_count, std::vector<unsigned int>* positions) const;
 
     // Configurable interface
 
@@ -218,7 +227,7 @@ class RecombinationPositionGenerator_RecombinationMap : public RecombinationPosi
     private:
 
     std::vector<std::string> filenames_;
-    std::vector< shared_ptr<RecombinationMap> > recombination_maps_;
+    std::vector< shared_ptr<const RecombinationMap> > recombination_maps_;
 
     void read_files();
 };
@@ -249,18 +258,28 @@ class RecombinationPositionGenerator_Composite : public RecombinationPositionGen
     RecombinationPositionGenerator_Composite(const std::string& id);
 
     virtual std::vector<unsigned int> get_positions(size_t chromosome_pair_index) const;
+    virtual void append_positions(size_t chromosome_pair_index, std::vector<unsigned int>& positions) const;
+    virtual void get_gamete_positions(size_t chromosome_pair_count, std::vector<unsigned int>* positions) const;
 
     // Configurable interface
 
     virtual std::string class_name() const {return "RecombinationPositionGenerator_Composite";}
     virtual Parameters parameters() const;
     virtual void configure(const Parameters& parameters, const Registry& registry);
+    virtual void initialize(const SimulatorConfig& config);
 
     private:
 
     RecombinationPositionGeneratorPtr default_rpg_;
     typedef std::map<size_t,RecombinationPositionGeneratorPtr> RPGMap;
     RPGMap rpg_map_;
+
+    // compiled at initialize(): generator for each chromosome pair, and the 
+    // generator for all of them, if there is only one
+    std::vector<const RecombinationPositionGenerator*> dispatch_;
+    const RecombinationPositionGenerator* single_rpg_;
+
+    const RecombinationPositionGenerator& rpg(size_t chromosome_pair_index) const;
 };
 
 
@@ -39,6 +39,7 @@
 #include "unit.hpp"
 #include <iostream>
 #include <iterator>
+#include <algorithm>
 #include <cstring>
 
 
@@ -263,6 +264,56 @@ void test_Configurable_RecombinationPositionGenerator_Uniform()
 }
 
 
+void test_append_positions()
+{
+    if (os_) *os_ << "test_append_positions()\n";
+
+    // append_positions() appends the same positions as get_positions() returns
+
+    PopulationConfigGeneratorPtr pcg(new PopulationConfigGenerator_ChromosomeLengths);
+    SimulatorConfig simconfig;
+    simconfig.population_config_generator = pcg;
+
+    Parameters parameters;
+    parameters.insert_name_value("rates", "1 2 30 ");
+
+    RecombinationPositionGenerator_Uniform rpg_uniform("dummy_uniform");
+    Configurable::Registry registry;
+    rpg_uniform.configure(parameters, registry);
+    rpg_uniform.initialize(simconfig);
+
+    RecombinationPositionGenerator_SingleCrossover rpg_single("dummy_single");
+    rpg_single.initialize(simconfig);
+
+    RecombinationPositionGenerator_Trivial rpg_trivial("dummy_trivial");
+
+    const RecombinationPositionGenerator* rpgs[] = {&rpg_uniform, &rpg_single, &rpg_trivial};
+
+    for (size_t r=0; r<3; ++r)
+    {
+        const size_t chromosome_pair_count = 3;
+        const size_t replicate_count = 100;
+
+        Random::seed(123);
+        vector< vector<unsigned int> > expected;
+        for (size_t i=0; i<replicate_count; ++i)
+            expected.push_back(rpgs[r]->get_positions(i % chromosome_pair_count));
+
+        Random::seed(123);
+        vector<unsigned int> buffer;
+        for (size_t i=0; i<replicate_count; ++i)
+        {
+            buffer.assign(1, 42); // existing contents are kept
+            rpgs[r]->append_positions(i % chromosome_pair_count, buffer);
+
+            unit_assert(buffer.size() == expected[i].size() + 1);
+            unit_assert(buffer[0] == 42);
+            unit_assert(equal(expected[i].begin(), expected[i].end(), buffer.begin() + 1));
+        }
+    }
+}
+
+
 class RPGCounter : public RecombinationPositionGenerator
 { 
     public:
@@ -313,8 +364,9 @@ void test_RecombinationPositionGenerator_Composite()
 
     unit_assert(parameters_in == parameters_out);
 
+    vector<unsigned int> positions;
     for (size_t i=0; i<10; ++i) rpg.get_positions(i);
-    for (size_t i=0; i<10; ++i) rpg.get_positions(i);
+    for (size_t i=0; i<10; ++i) rpg.append_positions(i, positions); // base class default via get_positions()
 
     unit_assert(rpg_3->counter.size() == 1 && rpg_3->counter[2] == 2);
     unit_assert(rpg_5->counter.size() == 1 && rpg_5->counter[4] == 2);
@@ -325,13 +377,76 @@ void test_RecombinationPositionGenerator_Composite()
 }
 
 
+void test_RecombinationPositionGenerator_Composite_dispatch()
+{
+    if (os_) *os_ << "test_RecombinationPositionGenerator_Composite_dispatch()\n";
+
+    PopulationConfigGeneratorPtr pcg(new PopulationConfigGenerator_ChromosomeLengths); // 3 chromosome pairs
+    SimulatorConfig simconfig;
+    simconfig.population_config_generator = pcg;
+
+    shared_ptr<RPGCounter> rpg_default(new RPGCounter("rpg_default"));
+    shared_ptr<RPGCounter> rpg_2(new RPGCounter("rpg_2"));
+
+    Configurable::Registry registry;
+    registry["rpg_default"] = rpg_default;
+    registry["rpg_2"] = rpg_2;
+
+    // compiled dispatch table
+
+    Parameters parameters;
+    parameters.insert_name_value("default_recombination_position_generator", "rpg_default");
+    parameters.insert_name_value("chromosome:recombination_position_generator", "2 rpg_2");
+
+    RecombinationPositionGenerator_Composite rpg("rpg");
+    rpg.configure(parameters, registry);
+    rpg.initialize(simconfig);
+
+    vector< vector<unsigned int> > positions(3, vector<unsigned int>(1, 42));
+    rpg.get_gamete_positions(3, &positions[0]);
+    rpg.append_positions(1, positions[1]);
+
+    for (size_t i=0; i<3; ++i) unit_assert(positions[i].empty()); // cleared
+    unit_assert(rpg_default->counter.size() == 2 && rpg_default->counter[0] == 1 && rpg_default->counter[2] == 1);
+    unit_assert(rpg_2->counter.size() == 1 && rpg_2->counter[1] == 2);
+
+    // single generator for all chromosomes: same draws as the generator itself
+
+    Parameters parameters_uniform;
+    parameters_uniform.insert_name_value("rate", "5");
+
+    RecombinationPositionGeneratorPtr rpg_uniform(new RecombinationPositionGenerator_Uniform("rpg_uniform"));
+    rpg_uniform->configure(parameters_uniform, registry);
+    rpg_uniform->initialize(simconfig);
+    registry["rpg_uniform"] = rpg_uniform;
+
+    Parameters parameters_single;
+    parameters_single.insert_name_value("default_recombination_position_generator", "rpg_uniform");
+
+    RecombinationPositionGenerator_Composite rpg_single("rpg_single");
+    rpg_single.configure(parameters_single, registry);
+    rpg_single.initialize(simconfig);
+
+    Random::seed(123);
+    vector< vector<unsigned int> > expected(3);
+    for (size_t i=0; i<3; ++i)
+        expected[i] = rpg_uniform->get_positions(i);
+
+    Random::seed(123);
+    rpg_single.get_gamete_positions(3, &positions[0]);
+    unit_assert(positions == expected);
+}
+
+
 void test()
 {
     test_RecombinationPositionGenerator_Trivial();
     test_RecombinationPositionGenerator_SingleCrossover();
     test_Configurable_RecombinationPositionGenerator_RecombinationMap();
     test_Configurable_RecombinationPositionGenerator_Uniform();
+    test_append_positions();
     test_RecombinationPositionGenerator_Composite();
+    test_RecombinationPositionGenerator_Composite_dispatch();
 }
 
 
@@ -34,6 +34,7 @@
 
 
 #include "ReporterImplementation.hpp"
+#include "HaplotypeChunkIndex.hpp"
 #include "boost/filesystem.hpp"
 #include "boost/filesystem/fstream.hpp"
 #include <stdexcept>
@@ -353,14 +354,15 @@ void Reporter_LD::update(size_t generation_index,
         if (genotypes1.size() != genotypes2.size())
             throw runtime_error("[Reporter_LD] Genotype vector size mismatch.");
 
-        double counts[2][2] = {{0, 0}, {0, 0}};
+        // haplotype counts from allele counts (binary alleles)
 
-        for (GenotypeData::const_iterator gt1=genotypes1.begin(), gt2=genotypes2.begin();
-             gt1!=genotypes1.end(); ++gt1, ++gt2)
-        {
-            ++counts[(size_t)genotype_first(*gt1)][(size_t)genotype_first(*gt2)];
-            ++counts[(size_t)genotype_second(*gt1)][(size_t)genotype_second(*gt2)];
-        }
+        const double count_1 = double(genotypes1.allele_count());
+        const double count_2 = double(genotypes2.allele_count());
+        const double count_11 = double(genotypes1.joint_allele_count(genotypes2));
+        const double haplotype_count = 2.0 * genotypes1.size();
+
+        double counts[2][2] = {{haplotype_count - count_1 - count_2 + count_11, count_2 - count_11}, 
+                               {count_1 - count_11, count_11}};
 
         double count_total = counts[0][0] + counts[0][1] + counts[1][0] + counts[1][1];
         double D = (counts[0][0]*counts[1][1] - counts[0][1]*counts[1][0])/count_total/count_total;
@@ -674,29 +676,29 @@ void Reporter_HaplotypeDiversity::update(size_t generation_index,
 
             //os << generation_index << " " << chromosome_pair_index + 1 << " " <<  population_index + 1  << endl; // TODO: remove
 
-            for (size_t position=0; position<entry.length; position+=entry.step)
-            {
-                map<unsigned int, double> counts; // haplotype id -> count 
-                double count_total = 0;
+            HaplotypeChunkIndex index;
+            index.build(population, chromosome_pair_index);
+            index.compact_ids();
 
-                ChromosomePairRangeIterator it = population.begin();
-                ChromosomePairRangeIterator end = population.end();
-                for (; it!=end; ++it)
-                {
-                    if (chromosome_pair_index >= it->size())
-                        throw runtime_error("[Reporter_HaplotypeDiversity] Invalid chromosome pair index.");
+            // distinct haplotypes are counted by stamping dense ids with the position ordinal
 
-                    const ChromosomePair& p = *(it->begin() + chromosome_pair_index);
+            vector<size_t> stamps(index.id_count(), 0); // dense id -> 1 + last position ordinal seen
+            size_t stamp = 0;
 
-                    unsigned int id1 = p.first.find_haplotype_chunk(position)->id;
-                    unsigned int id2 = p.second.find_haplotype_chunk(position)->id;
+            for (size_t position=0; position<entry.length; position+=entry.step)
+            {
+                size_t distinct_count = 0;
+                ++stamp;
 
-                    ++counts[id1];
-                    ++counts[id2];
-                    count_total += 2;
+                for (size_t i=0; i<index.chromosome_count(); ++i)
+                {
+                    const unsigned int dense_id = index.find_dense_id(i, position);
+                    if (stamps[dense_id] == stamp) continue;
+                    stamps[dense_id] = stamp;
+                    ++distinct_count;
                 }
 
-                os << counts.size() << " "; // for now, just report the number of different haplotypes
+                os << distinct_count << " "; // for now, just report the number of different haplotypes
             }
 
             os << endl;
@@ -991,6 +993,17 @@ void Reporter_HaplotypeFrequencies::write_haplotype_frequencies(std::ostream& os
 
     os << "# position group1 [group2 ...]\n";
 
+    HaplotypeChunkIndex index;
+    index.build(population, chromosome_pair_index);
+    index.compact_ids();
+
+    // groups are looked up once per distinct id, on first use (group() throws
+    // for ids it doesn't know, so ids never seen at a reported position are 
+    // left alone)
+
+    const size_t group_unknown = size_t(-1);
+    vector<size_t> groups(index.id_count(), group_unknown); // dense id -> group
+
     // one line per position
 
     for (size_t position=0; position<chromosome_length; position+=chromosome_step_)
@@ -998,21 +1011,13 @@ void Reporter_HaplotypeFrequencies::write_haplotype_frequencies(std::ostream& os
         vector<double> counts(haplotype_grouping_->group_count());
         double count_total = 0;
 
-        ChromosomePairRangeIterator it = population.begin();
-        ChromosomePairRangeIterator end = population.end();
-        for (; it!=end; ++it)
+        for (size_t i=0; i<index.chromosome_count(); ++i)
         {
-            if (it->size() == 0)
-                throw runtime_error("[Reporter_HaplotypeFrequencies] I am insane.");
-
-            const ChromosomePair& p = *(it->begin() + chromosome_pair_index);
-
-            unsigned int id1 = p.first.find_haplotype_chunk(position)->id;
-            unsigned int id2 = p.second.find_haplotype_chunk(position)->id;
-
-            ++counts[haplotype_grouping_->group(id1)];
-            ++counts[haplotype_grouping_->group(id2)];
-            count_total += 2;
+            const unsigned int dense_id = index.find_dense_id(i, position);
+            if (groups[dense_id] == group_unknown) 
+                groups[dense_id] = haplotype_grouping_->group(index.id(dense_id));
+            ++counts[groups[dense_id]];
+            count_total += 1;
         }
 
         // write the haplotype frequencies
@@ -1066,11 +1071,7 @@ void Reporter_Regions::update(size_t generation_index,
 
     PopulationDataPtrs::const_iterator population_data = population_datas.begin();
 
-    Loci loci_all;
-    
-    for (GenotypeMap::const_iterator it=(*population_data)->genotypes->begin(); 
-         it!=(*population_data)->genotypes->end(); ++it)
-        loci_all.insert(it->first);
+    Loci loci_all = (*population_data)->genotypes->loci();
 
     Loci loci_regions;
 
@@ -1123,9 +1124,7 @@ void Reporter_Regions::update(size_t generation_index,
         for (Loci::const_iterator locus=loci_regions.begin(); locus!=loci_regions.end(); ++locus)
         {
             const GenotypeData& genotypes = *(*population_data)->genotypes->get(*locus);
-            size_t variant_count = 0;
-            for (GenotypeData::const_iterator g=genotypes.begin(); g!=genotypes.end(); ++g)
-                variant_count += size_t(genotype_sum(*g));
+            const size_t variant_count = genotypes.allele_count();
             if (variant_count > sfs.size())
                 throw runtime_error("[Reporter_Regions] Only implemented for 0/1 variants");
 
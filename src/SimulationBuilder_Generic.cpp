@@ -424,6 +424,26 @@ void process_command_line_parameters(const Parameters& command_line_parameters,
         simconfig.seed = command_line_parameters.value<unsigned int>("seed");
         simconfig.use_random_seed = false;
     }
+
+    if (command_line_parameters.count("thread_count")) 
+        simconfig.thread_count = command_line_parameters.value<size_t>("thread_count");
+
+    if (command_line_parameters.count("parent_sampler")) 
+        simconfig.parent_sampler = SimulatorConfig::parent_sampler_from_name(
+            command_line_parameters.value<string>("parent_sampler"));
+
+    if (command_line_parameters.count("offspring_allocation")) 
+        simconfig.offspring_allocation = SimulatorConfig::offspring_allocation_from_name(
+            command_line_parameters.value<string>("offspring_allocation"));
+
+    if (command_line_parameters.count("mutation_prune_step")) 
+        simconfig.mutation_prune_step = command_line_parameters.value<size_t>("mutation_prune_step");
+
+    if (command_line_parameters.count("lazy_genotyping")) 
+        simconfig.lazy_genotyping = command_line_parameters.value<bool>("lazy_genotyping");
+
+    if (command_line_parameters.count("write_genotyping")) 
+        simconfig.write_genotyping = command_line_parameters.value<bool>("write_genotyping");
 }
 
 
@@ -532,7 +552,8 @@ void handle_mutation_generation(SimulatorConfig& simconfig)
         shared_ptr<VariantIndicator_Mutable> vi_mutable(new VariantIndicator_Mutable("variant_indicator_mutable_wrapper",
                                                                                      unused_id_start,
                                                                                      simconfig.variant_indicator,
-                                                                                     simconfig.output_directory));
+                                                                                     simconfig.output_directory,
+                                                                                     simconfig.mutation_prune_step));
         simconfig.variant_indicator = vi_mutable;
         simconfig.reporters.push_back(vi_mutable);
     }
@@ -53,7 +53,13 @@ SimulatorConfig::SimulatorConfig(const string& id)
     seed(0), 
     write_popconfig(false),
     write_vi(false),
-    use_random_seed(false)
+    use_random_seed(false),
+    thread_count(1),
+    parent_sampler(Population::ParentSampler_CDF),
+    offspring_allocation(Population::OffspringAllocation_PerChild),
+    mutation_prune_step(0),
+    lazy_genotyping(true),
+    write_genotyping(false)
 {}
 
 
@@ -65,6 +71,18 @@ Parameters SimulatorConfig::parameters() const
     parameters.insert_name_value("output_directory", output_directory);
     parameters.insert_name_value("write_popconfig", write_popconfig);
     parameters.insert_name_value("write_vi", write_vi);
+    if (thread_count != 1)
+        parameters.insert_name_value("thread_count", thread_count);
+    if (parent_sampler == Population::ParentSampler_Alias)
+        parameters.insert_name_value("parent_sampler", "alias");
+    if (offspring_allocation == Population::OffspringAllocation_Multinomial)
+        parameters.insert_name_value("offspring_allocation", "multinomial");
+    if (mutation_prune_step)
+        parameters.insert_name_value("mutation_prune_step", mutation_prune_step);
+    if (!lazy_genotyping)
+        parameters.insert_name_value("lazy_genotyping", lazy_genotyping);
+    if (write_genotyping)
+        parameters.insert_name_value("write_genotyping", write_genotyping);
 
     if (population_config_generator.get())
         parameters.insert_name_value("population_config_generator", population_config_generator->object_id());
@@ -102,6 +120,14 @@ void SimulatorConfig::configure(const Parameters& parameters, const Registry& re
     output_directory = parameters.value<string>("output_directory", "");
     write_popconfig = parameters.value<bool>("write_popconfig", false);
     write_vi = parameters.value<bool>("write_vi", false);
+    thread_count = parameters.value<size_t>("thread_count", 1);
+
+    parent_sampler = parent_sampler_from_name(parameters.value<string>("parent_sampler", "cdf"));
+    offspring_allocation = offspring_allocation_from_name(parameters.value<string>("offspring_allocation", "per_child"));
+
+    mutation_prune_step = parameters.value<size_t>("mutation_prune_step", 0);
+    lazy_genotyping = parameters.value<bool>("lazy_genotyping", true);
+    write_genotyping = parameters.value<bool>("write_genotyping", false);
 
     population_config_generator = registry.get<PopulationConfigGenerator>(
         parameters.value<string>("population_config_generator"));
@@ -155,6 +181,22 @@ void SimulatorConfig::write_child_configurations(ostream& os, set<string>& ids_w
 }
 
 
+Population::ParentSampler SimulatorConfig::parent_sampler_from_name(const string& name)
+{
+    if (name == "cdf") return Population::ParentSampler_CDF;
+    if (name == "alias") return Population::ParentSampler_Alias;
+    throw runtime_error(("[SimulatorConfig] Unknown parent_sampler: " + name).c_str());
+}
+
+
+Population::OffspringAllocation SimulatorConfig::offspring_allocation_from_name(const string& name)
+{
+    if (name == "per_child") return Population::OffspringAllocation_PerChild;
+    if (name == "multinomial") return Population::OffspringAllocation_Multinomial;
+    throw runtime_error(("[SimulatorConfig] Unknown offspring_allocation: " + name).c_str());
+}
+
+
 //
 // Simulator
 //
@@ -162,11 +204,19 @@ void SimulatorConfig::write_child_configurations(ostream& os, set<string>& ids_w
 
 Simulator::Simulator(const SimulatorConfig& config)
 :   config_(config),
+    genotyper_(Genotyper::Method_Auto, config.thread_count),
     current_generation_index_(0), 
     current_populations_(new PopulationPtrs),
+    spare_populations_(new PopulationPtrs),
     current_population_datas_(new PopulationDataPtrs),
-    update_step_(1)
+    update_step_(1),
+    genotype_columns_requested_(0),
+    genotype_columns_computed_(0)
 {
+    mating_options_.thread_count = config_.thread_count;
+    mating_options_.parent_sampler = config_.parent_sampler;
+    mating_options_.offspring_allocation = config_.offspring_allocation;
+
     const size_t generation_count = config_.population_config_generator->generation_count();
     update_step_ = max(int(pow(10.0, int(log10(generation_count))-1)), 1);
     if (update_step_ > 10000) update_step_ = 10000;
@@ -261,7 +311,9 @@ void Simulator::simulate_single_generation() // main loop iteration
         popconfigs, 
         *current_populations_, 
         *current_population_datas_, 
-        config_.recombination_position_generators);
+        config_.recombination_position_generators,
+        *spare_populations_,
+        mating_options_);
 
     // generate mutations
 
@@ -280,6 +332,20 @@ void Simulator::simulate_single_generation() // main loop iteration
                                         current_generation_index_,
                                         is_final_generation);
 
+    // quantitative trait loci are read below; with lazy genotyping, the other
+    // loci are genotyped only if a reporter reads them (GenotypeMap::get())
+
+    Loci loci_eager = loci_all;
+    Loci loci_deferred;
+
+    if (config_.lazy_genotyping)
+    {
+        loci_eager = construct_loci_list(config_.quantitative_traits, ReporterPtrs(), 
+                                         current_generation_index_, is_final_generation);
+        set_difference(loci_all.begin(), loci_all.end(), loci_eager.begin(), loci_eager.end(),
+                       inserter(loci_deferred, loci_deferred.end()));
+    }
+
     // allocate PopulationData for each population
     // note: construct individually, since each one allocates memory for maps
 
@@ -301,8 +367,14 @@ void Simulator::simulate_single_generation() // main loop iteration
         (*popdata)->population_index = population_index;
         (*popdata)->population_size = (*population)->population_size();
 
-        genotyper_.genotype(loci_all, **population, *config_.variant_indicator, 
+        genotyper_.genotype(loci_eager, **population, *config_.variant_indicator, 
             *(*popdata)->genotypes);
+
+        if (!loci_deferred.empty())
+            (*popdata)->genotypes->defer(loci_deferred, **population, *config_.variant_indicator, genotyper_);
+
+        genotype_columns_requested_ += loci_all.size();
+        genotype_columns_computed_ += loci_eager.size();
     }
 
     // calculate quantitative trait values
@@ -315,6 +387,8 @@ void Simulator::simulate_single_generation() // main loop iteration
 
     // update reporters
 
+    end_genotype_deferral();
+    spare_populations_ = current_populations_; // recycled by create_populations() next generation
     current_populations_ = next_populations;
     current_population_datas_ = next_population_datas;
 
@@ -363,6 +437,29 @@ void Simulator::update_final()
         const bool is_final_generation = true;
         (*reporter)->update(current_generation_index_, *current_populations_, *current_population_datas_, is_final_generation);
     }
+
+    end_genotype_deferral();
+
+    if (config_.write_genotyping)
+    {
+        bfs::ofstream os(bfs::path(config_.output_directory) / "forqs.genotyping.txt");
+        if (!os)
+            throw runtime_error("[Simulator] Unable to open forqs.genotyping.txt");
+        os << "genotype_columns_requested " << genotype_columns_requested_ << endl
+           << "genotype_columns_computed " << genotype_columns_computed_ << endl;
+    }
+}
+
+
+void Simulator::end_genotype_deferral()
+{
+    for (PopulationDataPtrs::const_iterator data=current_population_datas_->begin(); 
+         data!=current_population_datas_->end(); ++data)
+    {
+        GenotypeMap& genotypes = *(*data)->genotypes;
+        genotype_columns_computed_ += genotypes.computed_count();
+        genotypes.end_deferral();
+    }
 }
 
 
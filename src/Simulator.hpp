@@ -72,6 +72,7 @@ typedef std::vector<ReporterPtr> ReporterPtrs;
 /// output_directory = \<string\> | none | required
 /// seed = \<float\> | 0 | optional
 /// write_popconfig = \<int\> | 0 (= don't write) | optional
+/// write_genotyping = \<int\> | 0 (= don't write) | optional
 ///
 /// References to top-level modules:
 /// parameter | default | notes
@@ -95,6 +96,12 @@ struct SimulatorConfig : public Configurable
     bool write_popconfig;
     bool write_vi;
     bool use_random_seed;
+    size_t thread_count; // see Population::MatingOptions and Genotyper
+    Population::ParentSampler parent_sampler; // "cdf" or "alias"
+    Population::OffspringAllocation offspring_allocation; // "per_child" or "multinomial"
+    size_t mutation_prune_step; // 0 (never) or generations between VariantIndicator_Mutable::prune()
+    bool lazy_genotyping; // genotype loci not needed by quantitative traits on first use
+    bool write_genotyping; // write genotype column counts to forqs.genotyping.txt
 
     PopulationConfigGeneratorPtr population_config_generator;
     RecombinationPositionGeneratorPtrs recombination_position_generators;
@@ -111,6 +118,10 @@ struct SimulatorConfig : public Configurable
     virtual Parameters parameters() const;
     virtual void configure(const Parameters& parameters, const Registry& registry);
     void write_child_configurations(std::ostream& os, std::set<std::string>& ids_written) const;
+
+    // parameter values for parent_sampler and offspring_allocation; throw on unknown names
+    static Population::ParentSampler parent_sampler_from_name(const std::string& name);
+    static Population::OffspringAllocation offspring_allocation_from_name(const std::string& name);
 };
 
 
@@ -130,13 +141,21 @@ class Simulator
 
     SimulatorConfig config_;
     Genotyper genotyper_;
+    Population::MatingOptions mating_options_;
 
     size_t current_generation_index_;
     PopulationPtrsPtr current_populations_;
+    PopulationPtrsPtr spare_populations_; // previous generation, double-buffered with current
     PopulationDataPtrsPtr current_population_datas_;
     size_t update_step_;
 
+    // genotype columns (loci x populations) needed by all modules, and actually computed
+    size_t genotype_columns_requested_;
+    size_t genotype_columns_computed_;
+
     bfs::ofstream os_popconfigs_;
+
+    void end_genotype_deferral();
 };
 
 
@@ -79,6 +79,9 @@ void test_Configurable_SimulatorConfig()
     parameters_in.insert_name_value("output_directory", "blah");
     parameters_in.insert_name_value("write_popconfig", true);
     parameters_in.insert_name_value("write_vi", true);
+    parameters_in.insert_name_value("thread_count", 4);
+    parameters_in.insert_name_value("parent_sampler", "alias");
+    parameters_in.insert_name_value("offspring_allocation", "multinomial");
 
     SimulatorConfig config("dummy_id");
     config.configure(parameters_in, registry);
@@ -51,6 +51,13 @@ void VariantIndicator::write_file(const std::string& filename) const
 }
 
 
+void VariantIndicator::lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const
+{
+    for (size_t i=0; i<count; ++i)
+        values[i] = (*this)(chunk_ids[i], locus);
+}
+
+
 unsigned int VariantIndicator::mutate(unsigned int old_chunk_id, const Locus& locus, unsigned int value)
 {
     throw runtime_error("[VariantIndicator::mutate()] Not implemented.");
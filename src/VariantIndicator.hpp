@@ -58,6 +58,11 @@ class VariantIndicator : public virtual Configurable
     public:
 
     virtual unsigned int operator()(unsigned int chunk_id, const Locus& locus) const = 0;
+
+    // batch version: values[i] = (*this)(chunk_ids[i], locus) for i < count; 
+    // implementations resolve the locus once per call; the default calls operator()
+    virtual void lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const;
+
     virtual void write_file(const std::string& filename) const;
     virtual unsigned int mutate(unsigned int old_chunk_id, const Locus& locus, unsigned int value); // returns new chunk id
     virtual ~VariantIndicator() {}
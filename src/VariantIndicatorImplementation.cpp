@@ -34,11 +34,23 @@
 
 
 #include "VariantIndicatorImplementation.hpp"
+#include <algorithm>
 
 
 using namespace std;
 
 
+//
+// VariantIndicator_Trivial
+//
+
+
+void VariantIndicator_Trivial::lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const
+{
+    fill(values, values + count, 0u);
+}
+
+
 //
 // VariantIndicator_Composite
 //
@@ -56,6 +68,41 @@ unsigned int VariantIndicator_Composite::operator()(unsigned int chunk_id, const
 }
 
 
+void VariantIndicator_Composite::lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const
+{
+    // each child is asked only for the ids that are still 0
+
+    fill(values, values + count, 0u);
+
+    vector<unsigned int> ids(chunk_ids, chunk_ids + count);
+    vector<size_t> indices(count);
+    for (size_t i=0; i<count; ++i) indices[i] = i;
+    vector<unsigned int> child_values(count);
+
+    for (VariantIndicatorPtrs::const_iterator it=variant_indicators_.begin(); it!=variant_indicators_.end() && !ids.empty(); ++it)
+    {
+        (*it)->lookup(locus, &ids[0], ids.size(), &child_values[0]);
+
+        size_t remaining = 0;
+        for (size_t i=0; i<ids.size(); ++i)
+        {
+            if (child_values[i] != 0)
+            {
+                values[indices[i]] = child_values[i];
+            }
+            else
+            {
+                ids[remaining] = ids[i];
+                indices[remaining++] = indices[i];
+            }
+        }
+
+        ids.resize(remaining);
+        indices.resize(remaining);
+    }
+}
+
+
 Parameters VariantIndicator_Composite::parameters() const 
 {
     ostringstream ids;
@@ -103,6 +150,36 @@ unsigned int VariantIndicator_IDRange::operator()(unsigned int chunk_id, const L
 }
 
 
+void VariantIndicator_IDRange::lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const
+{
+    pair<EntryMap::const_iterator,EntryMap::const_iterator> range = entries_.equal_range(locus);
+
+    if (range.first == range.second)
+    {
+        fill(values, values + count, 0u);
+        return;
+    }
+
+    for (size_t i=0; i<count; ++i)
+    {
+        const unsigned int chunk_id = chunk_ids[i];
+        values[i] = 0;
+
+        for (EntryMap::const_iterator it=range.first; it!=range.second; ++it)
+        {
+            const Entry& entry = it->second;
+            if (chunk_id >= entry.id_start && 
+                chunk_id < entry.id_start + entry.id_count &&
+                ((chunk_id - entry.id_start) % entry.id_step) == 0)
+            {
+                values[i] = entry.value;
+                break;
+            }
+        }
+    }
+}
+
+
 Parameters VariantIndicator_IDRange::parameters() const 
 {
     Parameters parameters;
@@ -164,6 +241,22 @@ unsigned int VariantIndicator_IDSet::operator()(unsigned int chunk_id, const Loc
 }
 
 
+void VariantIndicator_IDSet::lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const
+{
+    EntryMap::const_iterator it = entries_.find(locus);
+
+    if (it == entries_.end())
+    {
+        fill(values, values + count, 0u);
+        return;
+    }
+
+    const Entry& entry = it->second;
+    for (size_t i=0; i<count; ++i)
+        values[i] = entry.ids.count(chunk_ids[i]) ? entry.value : 0;
+}
+
+
 void VariantIndicator_IDSet::write_file(const std::string& filename) const
 {
     ofstream os(filename.c_str());
@@ -204,15 +297,15 @@ void VariantIndicator_IDSet::configure(const Parameters& parameters, const Regis
     {
         string id_locus;
         unsigned int value = 0;
-        set<unsigned int> ids;
+        vector<unsigned int> ids;
 
         istringstream iss(*it);
         iss >> id_locus >> value;
-        copy(istream_iterator<unsigned int>(iss), istream_iterator<unsigned int>(), inserter(ids, ids.end()));
+        copy(istream_iterator<unsigned int>(iss), istream_iterator<unsigned int>(), back_inserter(ids));
 
         const Locus& locus = *registry.get<Locus>(id_locus);
 
-        entries_.insert(make_pair(locus, Entry(value, ids)));
+        entries_.insert(make_pair(locus, Entry(value, IDSet(ids))));
     }
 }
 
@@ -368,14 +461,14 @@ void VariantIndicator_Random::initialize(const SimulatorConfig& simconfig)
                 vector<size_t> indices = 
                     Random::random_indices_without_replacement(id_count, size_t(*f * id_count));
 
-                set<unsigned int> ids;
+                vector<unsigned int> ids;
+                ids.reserve(indices.size());
                 for (vector<size_t>::const_iterator index=indices.begin(); index!=indices.end(); ++index)
-                    ids.insert(id_start + *index);
+                    ids.push_back(id_start + *index);
                 
                 if (entries_.count(*locus) == 0)
                     entries_.insert(make_pair(*locus, Entry(value)));
-                copy(ids.begin(), ids.end(), 
-                     inserter(entries_.at(*locus).ids, entries_.at(*locus).ids.begin()));
+                entries_.at(*locus).ids.insert(ids);
             }
         }
     }
@@ -420,6 +513,35 @@ unsigned int VariantIndicator_File::operator()(unsigned int chunk_id, const Locu
 }
 
 
+void VariantIndicator_File::lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const
+{
+    if (!ms_.get())
+        throw runtime_error("[VariantIndicator_File] Null ms file pointer.");
+
+    for (size_t i=0; i<count; ++i)
+    {
+        if (chunk_ids[i] >= ms_->sequences.size())
+        {
+            ostringstream oss;
+            oss << "[VariantIndicator_File] Haplotype id " << chunk_ids[i] << " out of range.";
+            throw runtime_error(oss.str().c_str());
+        }
+    }
+
+    map<Locus, size_t>::const_iterator it = locus_index_map_.find(locus);
+
+    if (it == locus_index_map_.end())
+    {
+        fill(values, values + count, 0u);
+        return;
+    }
+
+    const size_t locus_index = it->second;
+    for (size_t i=0; i<count; ++i)
+        values[i] = ms_->sequences[chunk_ids[i]][locus_index];
+}
+
+
 Parameters VariantIndicator_File::parameters() const 
 {
     Parameters parameters;
@@ -646,9 +768,10 @@ void VariantIndicator_TwoLocusLD::initialize_internal()
 VariantIndicator_Mutable::VariantIndicator_Mutable(const string& id, 
                                                    unsigned int unused_id_start, 
                                                    VariantIndicatorPtr vi,
-                                                   const string& output_directory)
+                                                   const string& output_directory,
+                                                   size_t prune_step)
 :   Configurable(id), unused_id_start_(unused_id_start), unused_id_current_(unused_id_start), 
-    vi_(vi), outdir_(output_directory)
+    vi_(vi), outdir_(output_directory), prune_step_(prune_step), flat_begin_(unused_id_start)
 {
     const bool debug = false;
     if (debug && !output_directory.empty())
@@ -661,34 +784,401 @@ VariantIndicator_Mutable::VariantIndicator_Mutable(const string& id,
 } 
 
 
+const VariantIndicator_Mutable::Mutation* VariantIndicator_Mutable::find_pruned_mutation(unsigned int chunk_id) const
+{
+    vector<unsigned int>::const_iterator it = lower_bound(pruned_ids_.begin(), pruned_ids_.end(), chunk_id);
+    if (it == pruned_ids_.end() || *it != chunk_id) return 0;
+    return &pruned_mutations_[it - pruned_ids_.begin()];
+}
+
+
+unsigned int VariantIndicator_Mutable::find_mutant(unsigned int chunk_id, size_t locus_index) const
+{
+    const LocusInfo& info = loci_[locus_index];
+    if (info.ids.empty() || chunk_id < info.ids.front()) return -1u;
+    const unsigned int first_id = info.ids.front();
+
+    const Mutation* m = find_mutation(chunk_id);
+    if (!m) return -1u; // not a mutant id: no walk, not memoized
+
+    MemoEntry* const memo = info.memo.empty() ? 0 : &info.memo[0];
+    const unsigned int memo_mask = (unsigned int)info.memo.size() - 1;
+
+    unsigned int result = -1u;
+
+    for (unsigned int id=chunk_id; m && id>=first_id; m=find_mutation(id))
+    {
+        if (memo)
+        {
+            const MemoEntry entry = memo[id & memo_mask];
+
+            if (unsigned(entry >> 32) == id)
+            {
+                result = unsigned(entry);
+                if (id == chunk_id) return result;
+                break;
+            }
+        }
+
+        if (m->locus_index == locus_index) 
+        {
+            result = id;
+            break;
+        }
+
+        id = m->parent;
+    }
+
+    if (memo)
+        memo[chunk_id & memo_mask] = MemoEntry(chunk_id) << 32 | result;
+
+    return result;
+}
+
+
+void VariantIndicator_Mutable::memo_reserve(size_t locus_index, size_t count) const
+{
+    if (locus_index == size_t(-1)) return;
+
+    const size_t memo_size_min = 64;
+    const size_t memo_size_max = 4096;
+
+    const LocusInfo& info = loci_[locus_index];
+    info.memo_insert_count += count;
+
+    // grow while the memo is less than half as large as the number of inserts
+
+    if (info.memo.size() >= memo_size_max || info.memo_insert_count < info.memo.size()/2)
+        return;
+
+    size_t size = max(memo_size_min, 2*info.memo.size());
+    while (size < memo_size_max && info.memo_insert_count >= size/2) size *= 2;
+
+    vector<MemoEntry> memo(size, MemoEntry(-1)); // id -1u: empty
+
+    for (vector<MemoEntry>::const_iterator it=info.memo.begin(); it!=info.memo.end(); ++it)
+        if (unsigned(*it >> 32) != -1u) memo[unsigned(*it >> 32) & (size-1)] = *it;
+
+    info.memo.swap(memo);
+}
+
+
+size_t VariantIndicator_Mutable::find_locus_index(const Locus& locus) const
+{
+    map<Locus, size_t>::const_iterator it = locus_indices_.find(locus);
+    return it != locus_indices_.end() ? it->second : size_t(-1);
+}
+
+
+bool VariantIndicator_Mutable::resolve(unsigned int chunk_id, size_t locus_index, unsigned int& result) const
+{
+    if (locus_index != size_t(-1))
+    {
+        const unsigned int id = find_mutant(chunk_id, locus_index);
+
+        if (id != -1u)
+        {
+            result = find_mutation(id)->value; // mutant value
+            return true;
+        }
+
+        if (loci_[locus_index].fixed)
+        {
+            result = loci_[locus_index].fixed_value;
+            return true;
+        }
+    }
+
+    const Mutation* m = find_mutation(chunk_id);
+    result = m ? m->root : chunk_id;
+    return false;
+}
+
+
 unsigned int VariantIndicator_Mutable::operator()(unsigned int chunk_id, const Locus& locus) const
 {   
-    const IDValueMap empty;
-    const IDValueMap& id_value_map = id_value_maps_.count(locus) ? id_value_maps_.at(locus) : empty;
+    unsigned int result = 0;
 
-    unsigned int parent_id = chunk_id;
+    const size_t locus_index = find_locus_index(locus);
 
-    while (id_ancestry_.count(parent_id))
     {
-        if (id_value_map.count(parent_id))
-            return id_value_map.at(parent_id);  // return mutant value
+        boost::unique_lock<boost::shared_mutex> lock(memo_mutex_);
+        memo_reserve(locus_index, 1);
+    }
 
-        parent_id = id_ancestry_.at(parent_id); // walk back along chunk ancestry tree
+    {
+        boost::shared_lock<boost::shared_mutex> lock(memo_mutex_);
+        if (resolve(chunk_id, locus_index, result)) return result;
     }
 
-    return vi_.get() ? (*vi_)(parent_id, locus) : 0; // default to internal VariantIndicator
+    return vi_.get() ? (*vi_)(result, locus) : 0; // default to internal VariantIndicator
+}
+
+
+void VariantIndicator_Mutable::lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const
+{
+    // ids whose ancestry has no mutant value at this locus are passed to the 
+    // internal VariantIndicator in a single batch
+
+    vector<unsigned int> root_ids;
+    vector<size_t> root_indices;
+
+    const size_t locus_index = find_locus_index(locus);
+
+    {
+        boost::unique_lock<boost::shared_mutex> lock(memo_mutex_);
+        memo_reserve(locus_index, count);
+    }
+
+    {
+        boost::shared_lock<boost::shared_mutex> lock(memo_mutex_);
+
+        for (size_t i=0; i<count; ++i)
+        {
+            unsigned int result = 0;
+
+            if (resolve(chunk_ids[i], locus_index, result))
+            {
+                values[i] = result;
+            }
+            else
+            {
+                root_ids.push_back(result);
+                root_indices.push_back(i);
+            }
+        }
+    }
+
+    if (root_ids.empty()) return;
+
+    vector<unsigned int> root_values(root_ids.size(), 0);
+    if (vi_.get())
+        vi_->lookup(locus, &root_ids[0], root_ids.size(), &root_values[0]);
+
+    for (size_t j=0; j<root_ids.size(); ++j)
+        values[root_indices[j]] = root_values[j];
 }
 
 
 unsigned int VariantIndicator_Mutable::mutate(unsigned int old_chunk_id, const Locus& locus, unsigned int value)
 {
+    map<Locus, size_t>::const_iterator it = locus_indices_.find(locus);
+
+    if (it == locus_indices_.end())
+    {
+        it = locus_indices_.insert(make_pair(locus, loci_.size())).first;
+        loci_.push_back(LocusInfo(locus));
+    }
+
     unsigned int new_chunk_id = unused_id_current_++;
-    id_ancestry_[new_chunk_id] = old_chunk_id;
-    id_value_maps_[locus][new_chunk_id] = value;
+
+    const Mutation* old_mutation = find_mutation(old_chunk_id);
+
+    Mutation m;
+    m.parent = old_chunk_id;
+    m.root = old_mutation ? old_mutation->root : old_chunk_id;
+    m.locus_index = it->second;
+    m.value = value;
+    mutations_.push_back(m);
+
+    loci_[it->second].ids.push_back(new_chunk_id);
+
     return new_chunk_id;
 }
 
 
+namespace {
+
+
+// per-locus summary of the mutations resolved by the chunks covering the locus
+
+struct Observation
+{
+    unsigned int id;    // first mutant id resolved, -1u if none
+    bool baseline;      // some chunk resolved to no mutation
+    bool mixed;         // more than one mutant id resolved
+
+    Observation() : id(-1u), baseline(false), mixed(false) {}
+
+    void add(unsigned int mutant_id)
+    {
+        if (mutant_id == -1u) 
+            baseline = true;
+        else if (id == -1u) 
+            id = mutant_id;
+        else if (id != mutant_id) 
+            mixed = true;
+    }
+};
+
+
+struct HasLowerPosition
+{
+    const vector<Locus>& loci;
+    HasLowerPosition(const vector<Locus>& _loci) : loci(_loci) {}
+    bool operator()(size_t a, size_t b) const {return loci[a].position < loci[b].position;}
+};
+
+
+} // namespace
+
+
+void VariantIndicator_Mutable::prune(const PopulationPtrs& populations)
+{
+    if (populations.empty() || mutation_count() == 0) return;
+
+    // mark: collect live mutant ids, and resolve each locus for every chunk covering it
+
+    vector<Locus> loci;
+    for (vector<LocusInfo>::const_iterator it=loci_.begin(); it!=loci_.end(); ++it)
+        loci.push_back(it->locus);
+
+    vector< vector<size_t> > pair_loci; // locus indices for each chromosome pair, by position
+    for (size_t i=0; i<loci.size(); ++i)
+    {
+        if (pair_loci.size() <= loci[i].chromosome_pair_index)
+            pair_loci.resize(loci[i].chromosome_pair_index + 1);
+        pair_loci[loci[i].chromosome_pair_index].push_back(i);
+    }
+
+    for (vector< vector<size_t> >::iterator it=pair_loci.begin(); it!=pair_loci.end(); ++it)
+        sort(it->begin(), it->end(), HasLowerPosition(loci));
+
+    vector<unsigned int> live_ids;
+    vector<unsigned int> observed_ids;
+    vector<Observation> observations(loci_.size());
+
+    for (PopulationPtrs::const_iterator population=populations.begin(); population!=populations.end(); ++population)
+    for (size_t n=0; n<(*population)->population_size(); ++n)
+    {
+        const ChromosomePairRange range = (*population)->chromosome_pair_range(n);
+
+        for (size_t pair=0; pair<range.size(); ++pair)
+        for (size_t which=0; which<2; ++which)
+        {
+            const HaplotypeChunks& chunks = which ? range.begin()[pair].second.haplotype_chunks() : 
+                                                    range.begin()[pair].first.haplotype_chunks();
+
+            for (const HaplotypeChunk* chunk=chunks.begin(); chunk!=chunks.end(); ++chunk)
+                if (find_mutation(chunk->id)) live_ids.push_back(chunk->id);
+
+            if (pair >= pair_loci.size()) continue;
+
+            // merge join: chunk is the last chunk starting at or before the locus
+
+            const HaplotypeChunk* chunk = chunks.begin();
+            const HaplotypeChunk* const chunk_last = chunks.end() - 1;
+
+            for (vector<size_t>::const_iterator i=pair_loci[pair].begin(); i!=pair_loci[pair].end(); ++i)
+            {
+                while (chunk != chunk_last && (chunk+1)->position <= loci[*i].position) ++chunk;
+                memo_reserve(*i, 1);
+                const unsigned int mutant_id = find_mutant(chunk->id, *i);
+                observations[*i].add(mutant_id);
+                if (mutant_id != -1u) observed_ids.push_back(mutant_id);
+            }
+        }
+    }
+
+    sort(live_ids.begin(), live_ids.end());
+    live_ids.erase(unique(live_ids.begin(), live_ids.end()), live_ids.end());
+    sort(observed_ids.begin(), observed_ids.end());
+    observed_ids.erase(unique(observed_ids.begin(), observed_ids.end()), observed_ids.end());
+
+    // sweep loci: a variant resolved by every chunk at its locus is fixed, and 
+    // its value becomes the locus default;  loci with no observed or fixed
+    // variants are dropped
+
+    vector<LocusInfo> new_loci;
+    map<Locus, size_t> new_locus_indices;
+    vector<unsigned int> locus_index_map(loci_.size(), -1u);
+    vector<char> locus_fixed_now(loci_.size(), 0);
+
+    for (size_t i=0; i<loci_.size(); ++i)
+    {
+        const Observation& o = observations[i];
+        LocusInfo info(loci_[i].locus);
+        info.fixed = loci_[i].fixed;
+        info.fixed_value = loci_[i].fixed_value;
+
+        if (o.id != -1u && !o.baseline && !o.mixed)
+        {
+            info.fixed = true;
+            info.fixed_value = find_mutation(o.id)->value;
+            locus_fixed_now[i] = 1;
+        }
+
+        if (o.id == -1u && !info.fixed) continue; // lost
+
+        locus_index_map[i] = new_loci.size();
+        new_locus_indices[info.locus] = new_loci.size();
+        new_loci.push_back(info);
+    }
+
+    // needed: observed mutations at loci that are not fixed now
+
+    vector<unsigned int> needed_ids;
+    for (vector<unsigned int>::const_iterator id=observed_ids.begin(); id!=observed_ids.end(); ++id)
+        if (!locus_fixed_now[find_mutation(*id)->locus_index])
+            needed_ids.push_back(*id);
+
+    // sweep ids: keep live and needed ids, with each parent pointer skipping 
+    // to the nearest kept ancestor;  ids are visited in ascending order, so 
+    // each parent's nearest kept ancestor is already known
+
+    vector<unsigned int> all_ids(pruned_ids_);
+    vector<Mutation> all_mutations(pruned_mutations_);
+    for (size_t i=0; i<mutations_.size(); ++i)
+    {
+        all_ids.push_back(flat_begin_ + i);
+        all_mutations.push_back(mutations_[i]);
+    }
+
+    vector<unsigned int> nearest(all_ids.size()); // nearest kept ancestor or self, or root
+    vector<unsigned int> new_ids;
+    vector<Mutation> new_mutations;
+
+    for (size_t i=0; i<all_ids.size(); ++i)
+    {
+        const unsigned int id = all_ids[i];
+        const Mutation& m = all_mutations[i];
+
+        vector<unsigned int>::const_iterator parent = lower_bound(all_ids.begin(), all_ids.begin() + i, m.parent);
+        const unsigned int parent_nearest = (parent != all_ids.begin() + i && *parent == m.parent) ?
+            nearest[parent - all_ids.begin()] : m.parent;
+
+        const bool needed = binary_search(needed_ids.begin(), needed_ids.end(), id);
+
+        if (!needed && !binary_search(live_ids.begin(), live_ids.end(), id))
+        {
+            nearest[i] = parent_nearest;
+            continue;
+        }
+
+        nearest[i] = id;
+
+        Mutation kept = m;
+        kept.parent = parent_nearest;
+        kept.locus_index = needed ? locus_index_map[m.locus_index] : -1u;
+        new_ids.push_back(id);
+        new_mutations.push_back(kept);
+
+        if (needed) new_loci[kept.locus_index].ids.push_back(id);
+    }
+
+    if (os_debug_.is_open())
+        os_debug_ << "prune: mutations " << all_ids.size() << " -> " << new_ids.size() 
+                  << ", loci " << loci_.size() << " -> " << new_loci.size() << endl;
+
+    pruned_ids_.swap(new_ids);
+    pruned_mutations_.swap(new_mutations);
+    vector<Mutation>().swap(mutations_);
+    flat_begin_ = unused_id_current_;
+    loci_.swap(new_loci);
+    locus_indices_.swap(new_locus_indices);
+}
+
+
 Parameters VariantIndicator_Mutable::parameters() const
 {
     Parameters parameters;
@@ -700,7 +1190,7 @@ Parameters VariantIndicator_Mutable::parameters() const
 
 void VariantIndicator_Mutable::configure(const Parameters& parameters, const Registry& registry)
 {
-    unused_id_current_ = unused_id_start_ = parameters.value<unsigned int>("unused_id_start");
+    unused_id_current_ = unused_id_start_ = flat_begin_ = parameters.value<unsigned int>("unused_id_start");
 
     if (parameters.count("variant_indicator"))
         vi_ = registry.get<VariantIndicator>(parameters.value<string>("variant_indicator"));
@@ -719,21 +1209,38 @@ void VariantIndicator_Mutable::write_child_configurations(ostream& os, set<strin
 }
 
 
+VariantIndicator_Mutable::IDAncestry VariantIndicator_Mutable::id_ancestry() const
+{
+    IDAncestry result;
+
+    for (size_t i=0; i<pruned_ids_.size(); ++i)
+        result.push_back(make_pair(pruned_ids_[i], pruned_mutations_[i].parent));
+
+    for (size_t i=0; i<mutations_.size(); ++i)
+        result.push_back(make_pair(flat_begin_ + unsigned(i), mutations_[i].parent));
+
+    return result;
+}
+
+
 void VariantIndicator_Mutable::report(std::ostream& os) const
 {
     os << "[VariantIndicator_Mutable]\n";
     os << "unused_id_current_: " << unused_id_current_ << endl;
 
-    os << "id_ancestry_:\n";
-    for (IDAncestry::const_iterator it=id_ancestry_.begin(); it!=id_ancestry_.end(); ++it)
+    os << "id_ancestry:\n";
+    IDAncestry ancestry = id_ancestry();
+    for (IDAncestry::const_iterator it=ancestry.begin(); it!=ancestry.end(); ++it)
         os << "  " << it->first << " -> " << it->second << endl;
 
-    os << "id_value_maps_\n";
-    for (IDValueMaps::const_iterator it=id_value_maps_.begin(); it!=id_value_maps_.end(); ++it)
+    os << "id_values:\n";
+    for (map<Locus, size_t>::const_iterator it=locus_indices_.begin(); it!=locus_indices_.end(); ++it)
     {
+        const LocusInfo& info = loci_[it->second];
         os << "  locus " << it->first << " values: ";
-        for (IDValueMap::const_iterator jt=it->second.begin(); jt!=it->second.end(); ++jt)
-            os << jt->first << ":" << jt->second << " ";
+        if (info.fixed) os << "fixed:" << info.fixed_value << " ";
+        for (vector<unsigned int>::const_iterator id=info.ids.begin(); id!=info.ids.end(); ++id)
+            os << *id << ":" << find_mutation(*id)->value << " ";
         os << endl;
     }
 }
@@ -755,10 +1262,15 @@ void VariantIndicator_Mutable::update(size_t generation_index,
     {
         bfs::ofstream os(outdir_ / "forqs.id_ancestry_map.txt");
         os << "# forqs id ancestry map [VariantIndicator_Mutable]\n";
-        for (IDAncestry::const_iterator it=id_ancestry_.begin(); it!=id_ancestry_.end(); ++it)
+        IDAncestry ancestry = id_ancestry();
+        for (IDAncestry::const_iterator it=ancestry.begin(); it!=ancestry.end(); ++it)
             os << it->first << " " << it->second << endl;
         os.close();
     }
+    else if (prune_step_ && generation_index % prune_step_ == 0)
+    {
+        prune(populations);
+    }
 }
 
 
@@ -768,8 +1280,8 @@ Loci VariantIndicator_Mutable::loci(size_t generation_index,
     Loci loci;
 
     if (is_final_generation)
-        for (IDValueMaps::const_iterator it=id_value_maps_.begin(); it!=id_value_maps_.end(); ++it)
-            loci.insert(it->first);
+        for (vector<LocusInfo>::const_iterator it=loci_.begin(); it!=loci_.end(); ++it)
+            loci.insert(it->locus);
 
     return loci;
 }
@@ -38,9 +38,12 @@
 
 
 #include "VariantIndicator.hpp"
+#include "IDSet.hpp"
 #include "MSFormat.hpp"
 #include "Random.hpp"
 #include "Reporter.hpp"
+#include "boost/thread/shared_mutex.hpp"
+#include "boost/cstdint.hpp"
 
 
 ///
@@ -69,6 +72,7 @@ class VariantIndicator_Trivial : public VariantIndicator
     VariantIndicator_Trivial(const std::string& id) : Configurable(id) {} 
 
     virtual unsigned int operator()(unsigned int chunk_id, const Locus& locus) const {return 0;}
+    virtual void lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const;
 
     // Configurable interface
 
@@ -102,6 +106,7 @@ class VariantIndicator_Composite : public VariantIndicator
     VariantIndicator_Composite(const std::string& id) : Configurable(id) {} 
 
     virtual unsigned int operator()(unsigned int chunk_id, const Locus& locus) const;
+    virtual void lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const;
 
     // Configurable interface
 
@@ -139,6 +144,7 @@ class VariantIndicator_IDRange : public VariantIndicator
     VariantIndicator_IDRange(const std::string& id) : Configurable(id) {} 
 
     virtual unsigned int operator()(unsigned int chunk_id, const Locus& locus) const;
+    virtual void lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const;
 
     // Configurable interface
 
@@ -188,6 +194,7 @@ class VariantIndicator_IDSet : public VariantIndicator
 
     VariantIndicator_IDSet(const std::string& id) : Configurable(id) {} 
     virtual unsigned int operator()(unsigned int chunk_id, const Locus& locus) const;
+    virtual void lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const;
     virtual void write_file(const std::string& filename) const;
 
     // Configurable interface
@@ -200,9 +207,9 @@ class VariantIndicator_IDSet : public VariantIndicator
     struct Entry
     {
         unsigned int value;
-        std::set<unsigned int> ids;
+        IDSet ids;
 
-        Entry(unsigned int _value = -1u, std::set<unsigned int> _ids = std::set<unsigned int>())
+        Entry(unsigned int _value = -1u, const IDSet& _ids = IDSet())
         :   value(_value), ids(_ids)
         {}
     };
@@ -304,6 +311,7 @@ class VariantIndicator_File : public VariantIndicator
     VariantIndicator_File(const std::string& id) : Configurable(id) {} 
 
     virtual unsigned int operator()(unsigned int chunk_id, const Locus& locus) const;
+    virtual void lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const;
 
     // Configurable interface
 
@@ -452,12 +460,22 @@ class VariantIndicator_Mutable : public VariantIndicator, public Reporter
     VariantIndicator_Mutable(const std::string& id,
                              unsigned int unused_id_start = 0,
                              VariantIndicatorPtr vi = VariantIndicatorPtr(),
-                             const std::string& output_directory = "");
+                             const std::string& output_directory = "",
+                             size_t prune_step = 0);
 
     virtual unsigned int operator()(unsigned int chunk_id, const Locus& locus) const;
+    virtual void lookup(const Locus& locus, const unsigned int* chunk_ids, size_t count, unsigned int* values) const;
 
     virtual unsigned int mutate(unsigned int old_chunk_id, const Locus& locus, unsigned int value);
 
+    // mark and sweep: drops mutant ids that are no longer present in the 
+    // populations (or ancestral to ids that are), and variants that have been
+    // lost or fixed;  called from update() every SimulatorConfig::mutation_prune_step
+    // generations
+    void prune(const PopulationPtrs& populations);
+
+    size_t mutation_count() const {return mutations_.size() + pruned_mutations_.size();}
+
     void report(std::ostream& os) const;
 
     // Configurable interface
@@ -486,12 +504,84 @@ class VariantIndicator_Mutable : public VariantIndicator, public Reporter
     bfs::path outdir_;
     bfs::ofstream os_debug_;
 
-    typedef std::map<unsigned int, unsigned int> IDAncestry;
-    IDAncestry id_ancestry_;
+    size_t prune_step_;
+
+    // mutant chunk ids are assigned consecutively, and each is created by a
+    // single mutation, so the ancestry is held in a flat array indexed by 
+    // (id - flat_begin_).  A mutant id is always greater than its parent's id, 
+    // so a walk at a locus can stop as soon as it passes below the first id 
+    // that mutated at that locus.
+    //
+    // prune() moves the surviving ids below flat_begin_ to a sorted array.
+
+    struct Mutation
+    {
+        unsigned int parent;        // parent chunk id
+        unsigned int root;          // non-mutant ancestor id (path-compressed)
+        unsigned int locus_index;   // index into loci_, -1u if no longer observed
+        unsigned int value;
+    };
+
+    unsigned int flat_begin_;
+    std::vector<Mutation> mutations_;           // ids [flat_begin_, unused_id_current_)
+    std::vector<unsigned int> pruned_ids_;      // ids < flat_begin_ kept by prune(), ascending
+    std::vector<Mutation> pruned_mutations_;
+
+    // find_mutant() results are memoized per locus in a direct-mapped table 
+    // keyed by chunk id, so that a walk usually ends at the first ancestor 
+    // already resolved.  Adding a mutation creates a new id without changing
+    // the ancestry of existing ids, so entries stay valid until prune(), which
+    // rebuilds the LocusInfos with empty memos.
+    //
+    // Lookups from several Genotyper threads resolve concurrently under a shared
+    // lock:  an entry is a single 64-bit word (chunk id << 32 | mutant), written
+    // with the same value by any thread that resolves the id, and the tables are
+    // only resized by memo_reserve() under the exclusive lock.
+
+    typedef boost::uint64_t MemoEntry;
+    struct LocusInfo
+    {
+        Locus locus;
+        std::vector<unsigned int> ids;  // mutant ids at the locus, ascending
+        bool fixed;                     // every chunk at the locus descends from a 
+        unsigned int fixed_value;       //   pruned mutation with this value
+
+        mutable std::vector<MemoEntry> memo;    // size 0 or a power of 2
+        mutable size_t memo_insert_count;       // upper bound: ids resolved so far
+
+        LocusInfo(const Locus& _locus) 
+        :   locus(_locus), fixed(false), fixed_value(0), memo_insert_count(0) 
+        {}
+    };
+
+    std::vector<LocusInfo> loci_;
+    std::map<Locus, size_t> locus_indices_;
+
+    const Mutation* find_mutation(unsigned int chunk_id) const
+    {
+        if (chunk_id >= flat_begin_ && chunk_id < unused_id_current_) 
+            return &mutations_[chunk_id - flat_begin_];
+        return chunk_id < flat_begin_ && !pruned_ids_.empty() ? find_pruned_mutation(chunk_id) : 0;
+    }
+
+    const Mutation* find_pruned_mutation(unsigned int chunk_id) const;
+
+    // id of the nearest ancestor (or self) that mutated at the locus, or -1u
+    unsigned int find_mutant(unsigned int chunk_id, size_t locus_index) const;
+
+    // sizes the memo for count more resolved ids (exclusive access)
+    void memo_reserve(size_t locus_index, size_t count) const;
+
+    mutable boost::shared_mutex memo_mutex_;
+
+    // index into loci_, or -1 if there are no mutations at the locus
+    size_t find_locus_index(const Locus& locus) const;
+
+    // returns mutant or fixed value at locus, or false and the id to look up in vi_
+    bool resolve(unsigned int chunk_id, size_t locus_index, unsigned int& result) const;
 
-    typedef std::map<unsigned int, unsigned int> IDValueMap;
-    typedef std::map<Locus, IDValueMap> IDValueMaps;
-    IDValueMaps id_value_maps_;
+    typedef std::vector< std::pair<unsigned int, unsigned int> > IDAncestry;
+    IDAncestry id_ancestry() const; // (id, parent) for all ids held, ascending
 };
 
 
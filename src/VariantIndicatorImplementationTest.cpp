@@ -34,19 +34,40 @@
 
 
 #include "VariantIndicatorImplementation.hpp"
+#include "Population_Organisms.hpp"
 #include "unit.hpp"
+#include "boost/lexical_cast.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/ref.hpp"
 #include <iostream>
 #include <iterator>
 #include <cstring>
 
 
 using namespace std;
+using boost::lexical_cast;
 
 
 ostream* os_ = 0;
 //ostream* os_ = &cout;
 
 
+// verify that the batch lookup() agrees with operator() for ids [0, id_end)
+
+void test_lookup(const VariantIndicator& vi, const Locus& locus, unsigned int id_end)
+{
+    vector<unsigned int> ids;
+    for (unsigned int id=0; id<id_end; ++id)
+        ids.push_back(id_end - 1 - id); // out of order
+
+    vector<unsigned int> values(ids.size(), 999);
+    vi.lookup(locus, &ids[0], ids.size(), &values[0]);
+
+    for (size_t i=0; i<ids.size(); ++i)
+        unit_assert(values[i] == vi(ids[i], locus));
+}
+
+
 class PCG_TestHW : public PopulationConfigGenerator
 {
     public:
@@ -275,6 +296,11 @@ void test_VariantIndicator_IDRange()
     unit_assert(vi(1000,locus4) == 0);
     unit_assert(vi(2000,locus4) == 0);
     unit_assert(vi(3000,locus4) == 0);
+
+    test_lookup(vi, *locus1, 3100);
+    test_lookup(vi, *locus2, 3100);
+    test_lookup(vi, *locus3, 3100);
+    test_lookup(vi, locus4, 3100);
 }
 
 
@@ -350,6 +376,11 @@ void test_VariantIndicator_IDSet()
     unit_assert(vi(2001,locus4) == 0);
     unit_assert(vi(3000,locus4) == 0);
     unit_assert(vi(3001,locus4) == 0);
+
+    test_lookup(vi, *locus1, 3100);
+    test_lookup(vi, *locus2, 3100);
+    test_lookup(vi, *locus3, 3100);
+    test_lookup(vi, locus4, 3100);
 }
 
 
@@ -623,6 +654,10 @@ void test_VariantIndicator_File()
         unit_assert(vi(id, *locus2) == int(id%3==1));
         unit_assert(vi(id, *locus3) == int(id%3==2));
     }
+
+    test_lookup(vi, *locus1, 12);
+    test_lookup(vi, *locus2, 12);
+    test_lookup(vi, *locus3, 12);
 }
 
 
@@ -732,6 +767,269 @@ void test_VariantIndicator_Mutable()
 
     for (unsigned int id=10; id<20; ++id)
         unit_assert(vi(id, *locus1) == 0 && vi(id, *locus2) == 0 && vi(id, *locus3) == 0);
+
+    test_lookup(vi, *locus1, id_mutant_3+2);
+    test_lookup(vi, *locus2, id_mutant_3+2);
+    test_lookup(vi, *locus3, id_mutant_3+2);
+}
+
+
+void test_VariantIndicator_Mutable_ancestry()
+{
+    if (os_) *os_ << "test_VariantIndicator_Mutable_ancestry()\n";
+
+    // random mutation history (long chains, several loci), checked against 
+    // a walk along a map-based ancestry tree
+
+    Random::seed(123);
+
+    LocusPtr locus0(new Locus("locus0", 0, 1000));
+    vector<Locus> loci;
+    for (unsigned int i=0; i<5; ++i)
+        loci.push_back(Locus("locus" + lexical_cast<string>(i), 0, (i+1)*1000));
+
+    Configurable::Registry registry;
+    registry["locus0"] = locus0;
+
+    Parameters parameters_vi_id_range;
+    parameters_vi_id_range.insert_name_value("locus:start:count:step:value", "locus0 0 10 2 1");
+    VariantIndicatorPtr vi_id_range(new VariantIndicator_IDRange("vi_id_range"));
+    vi_id_range->configure(parameters_vi_id_range, registry);
+
+    const unsigned int unused_id_start = 100;
+    VariantIndicator_Mutable vi("id_dummy", unused_id_start, vi_id_range);
+
+    map<unsigned int, unsigned int> ancestry;
+    map<Locus, map<unsigned int, unsigned int> > values;
+
+    vector<unsigned int> ids;
+    for (unsigned int id=0; id<20; ++id)
+        ids.push_back(id);
+
+    // lookups are checked as mutations accumulate, since the memo filled by
+    // earlier lookups must stay valid when mutations are added
+
+    for (size_t i=0; i<2000; ++i)
+    {
+        unsigned int parent = ids[ids.size() - 1 - Random::uniform_integer(0, min(int(ids.size()), 50) - 1)];
+        const Locus& locus = loci[Random::uniform_integer(0, int(loci.size()) - 1)];
+        unsigned int value = Random::uniform_integer(0, 3);
+        unsigned int id = vi.mutate(parent, locus, value);
+        unit_assert(id == unused_id_start + i);
+        ancestry[id] = parent;
+        values[locus][id] = value;
+        ids.push_back(id);
+
+        if (i%500 != 499) continue;
+
+        for (vector<Locus>::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+        {
+            for (vector<unsigned int>::const_iterator id=ids.begin(); id!=ids.end(); ++id)
+            {
+                unsigned int parent_id = *id;
+                unsigned int expected = -1u;
+
+                while (ancestry.count(parent_id) && expected == -1u)
+                {
+                    if (values[*locus].count(parent_id))
+                        expected = values[*locus][parent_id];
+                    parent_id = ancestry[parent_id];
+                }
+
+                if (expected == -1u) expected = (*vi_id_range)(parent_id, *locus);
+
+                unit_assert(vi(*id, *locus) == expected);
+            }
+
+            test_lookup(vi, *locus, ids.size() + 10);
+        }
+    }
+
+    // founder ids are looked up in the internal VariantIndicator
+
+    for (unsigned int id=0; id<20; ++id)
+        unit_assert(vi(id, *locus0) == (id<10 && id%2==0));
+    test_lookup(vi, *locus0, ids.size() + 10);
+
+    Loci loci_out = vi.loci(0, true);
+    unit_assert(loci_out.size() == loci.size());
+}
+
+
+struct ConcurrentLookup
+{
+    const VariantIndicator& vi;
+    const vector<Locus>& loci;
+    vector<unsigned int> ids;
+    vector<unsigned int> values; // [locus][id]
+
+    ConcurrentLookup(const VariantIndicator& _vi, const vector<Locus>& _loci, const vector<unsigned int>& _ids)
+    :   vi(_vi), loci(_loci), ids(_ids), values(_loci.size() * _ids.size())
+    {}
+
+    void operator()()
+    {
+        for (size_t i=0; i<loci.size(); ++i)
+            vi.lookup(loci[i], &ids[0], ids.size(), &values[i*ids.size()]);
+    }
+};
+
+
+void test_VariantIndicator_Mutable_threads()
+{
+    if (os_) *os_ << "test_VariantIndicator_Mutable_threads()\n";
+
+    // lookups from several threads share the memo, starting empty
+
+    Random::seed(123);
+
+    vector<Locus> loci;
+    for (unsigned int i=0; i<5; ++i)
+        loci.push_back(Locus("locus" + lexical_cast<string>(i), 0, (i+1)*1000));
+
+    const unsigned int unused_id_start = 100;
+    VariantIndicator_Mutable vi("id_dummy", unused_id_start);
+
+    vector<unsigned int> ids;
+    for (unsigned int id=0; id<unused_id_start; ++id)
+        ids.push_back(id);
+
+    for (size_t i=0; i<5000; ++i)
+    {
+        unsigned int parent = ids[ids.size() - 1 - Random::uniform_integer(0, min(int(ids.size()), 50) - 1)];
+        ids.push_back(vi.mutate(parent, loci[Random::uniform_integer(0, int(loci.size()) - 1)], 1 + i%3));
+    }
+
+    const size_t thread_count = 4;
+    vector< shared_ptr<ConcurrentLookup> > lookups;
+    boost::thread_group threads;
+
+    for (size_t t=0; t<thread_count; ++t)
+    {
+        rotate(ids.begin(), ids.begin() + ids.size()/thread_count, ids.end()); // different order per thread
+        lookups.push_back(shared_ptr<ConcurrentLookup>(new ConcurrentLookup(vi, loci, ids)));
+        threads.create_thread(boost::ref(*lookups.back()));
+    }
+
+    threads.join_all();
+
+    for (size_t t=0; t<thread_count; ++t)
+    for (size_t i=0; i<loci.size(); ++i)
+    for (size_t j=0; j<ids.size(); ++j)
+        unit_assert(lookups[t]->values[i*ids.size() + j] == vi(lookups[t]->ids[j], loci[i]));
+}
+
+
+void test_VariantIndicator_Mutable_prune()
+{
+    if (os_) *os_ << "test_VariantIndicator_Mutable_prune()\n";
+
+    // small random mating simulation with mutations:  lookups after periodic
+    // pruning must agree with an unpruned VariantIndicator_Mutable
+
+    Random::seed(123);
+
+    const size_t population_size = 10;
+    const size_t chromosome_pair_count = 2;
+    const unsigned int chromosome_length = 1000;
+
+    vector<Locus> loci;
+    for (unsigned int i=0; i<10; ++i)
+        loci.push_back(Locus("locus" + lexical_cast<string>(i), i%chromosome_pair_count, (i+1)*90));
+
+    Configurable::Registry registry;
+    registry["locus0"] = LocusPtr(new Locus(loci[0]));
+
+    Parameters parameters_vi_id_range;
+    parameters_vi_id_range.insert_name_value("locus:start:count:step:value", "locus0 0 10 1 1");
+    VariantIndicatorPtr vi_id_range(new VariantIndicator_IDRange("vi_id_range"));
+    vi_id_range->configure(parameters_vi_id_range, registry);
+
+    const unsigned int unused_id_start = 1000;
+    VariantIndicator_Mutable vi("vi", unused_id_start, vi_id_range);
+    VariantIndicator_Mutable vi_reference("vi_reference", unused_id_start, vi_id_range);
+
+    Organisms organisms;
+    for (unsigned int n=0; n<population_size; ++n)
+        organisms.push_back(Organism(2*n, 2*n+1, chromosome_pair_count));
+
+    PopulationPtrs populations(1);
+
+    for (size_t generation=0; generation<200; ++generation)
+    {
+        // recombination
+
+        Organisms children;
+        for (size_t n=0; n<population_size; ++n)
+        {
+            Organism::Gamete gametes[2];
+            for (size_t g=0; g<2; ++g)
+            {
+                const Organism& parent = organisms[Random::uniform_integer(0, population_size-1)];
+                for (size_t pair=0; pair<chromosome_pair_count; ++pair)
+                {
+                    vector<unsigned int> positions(1, Random::uniform_integer(1, chromosome_length));
+                    const ChromosomePair& cp = parent.chromosomePairs()[pair];
+                    gametes[g].push_back(Random::uniform_integer(0,1) ? Chromosome(cp.first, cp.second, positions) :
+                                                                        Chromosome(cp.second, cp.first, positions));
+                }
+            }
+            children.push_back(Organism(gametes[0], gametes[1]));
+        }
+
+        populations[0] = PopulationPtr(new Population_Organisms(children));
+
+        // mutation (as in Simulator)
+
+        for (size_t i=0; i<2; ++i)
+        {
+            const Locus& locus = loci[Random::uniform_integer(0, int(loci.size())-1)];
+            ChromosomePair& cp = populations[0]->chromosome_pair_range(Random::uniform_integer(0, population_size-1)).begin()[locus.chromosome_pair_index];
+            Chromosome& chromosome = Random::uniform_integer(0,1) ? cp.second : cp.first;
+            HaplotypeChunk& chunk = *chromosome.find_haplotype_chunk(locus.position);
+
+            unsigned int value = Random::uniform_integer(2,3);
+            unsigned int id = vi.mutate(chunk.id, locus, value);
+            unit_assert(vi_reference.mutate(chunk.id, locus, value) == id);
+            chunk.id = id;
+        }
+
+        if (generation % 5 == 0) vi.prune(populations);
+
+        // lookups
+
+        for (vector<Locus>::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+        {
+            vector<unsigned int> ids;
+            for (size_t n=0; n<population_size; ++n)
+            {
+                const ChromosomePair& cp = populations[0]->chromosome_pair_range(n).begin()[locus->chromosome_pair_index];
+                ids.push_back(cp.first.find_haplotype_chunk(locus->position)->id);
+                ids.push_back(cp.second.find_haplotype_chunk(locus->position)->id);
+            }
+
+            vector<unsigned int> values(ids.size());
+            vi.lookup(*locus, &ids[0], ids.size(), &values[0]);
+
+            for (size_t i=0; i<ids.size(); ++i)
+            {
+                unit_assert(vi(ids[i], *locus) == vi_reference(ids[i], *locus));
+                unit_assert(values[i] == vi_reference(ids[i], *locus));
+            }
+        }
+
+        Population_Organisms& p = dynamic_cast<Population_Organisms&>(*populations[0]);
+        organisms = p.organisms();
+    }
+
+    if (os_) 
+    {
+        *os_ << "mutation_count: " << vi.mutation_count() << " (reference " << vi_reference.mutation_count() << ")\n";
+        vi.report(*os_);
+    }
+
+    unit_assert(vi.mutation_count() < vi_reference.mutation_count());
+    unit_assert(vi.loci(0, true).size() <= vi_reference.loci(0, true).size());
 }
 
 
@@ -810,6 +1108,10 @@ void test_VariantIndicator_Composite()
     unit_assert(vi(31, locus3) == 0);
     unit_assert(vi(30, locus1) == 0);
     unit_assert(vi(30, locus2) == 0);
+
+    test_lookup(vi, locus1, 40);
+    test_lookup(vi, locus2, 40);
+    test_lookup(vi, locus3, 40);
 }
 
 
@@ -824,6 +1126,9 @@ void test()
     test_VariantIndicator_Random_2();
     test_VariantIndicator_File();
     test_VariantIndicator_Mutable();
+    test_VariantIndicator_Mutable_ancestry();
+    test_VariantIndicator_Mutable_threads();
+    test_VariantIndicator_Mutable_prune();
     test_VariantIndicator_Composite();
 }
 
@@ -34,6 +34,7 @@
 
 
 #include "Population_ChromosomePairs.hpp"
+#include "RecombinationMap.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -53,6 +54,7 @@ int main(int argc, char* argv[])
         usage << "Functions:\n";
         usage << "    forqs_aux txt2pop filename_in filename_out\n";
         usage << "    forqs_aux pop2txt filename_in filename_out\n";
+        usage << "    forqs_aux txt2map genetic_map_filename_in filename_out\n";
         usage << endl;
         usage << "Darren Kessner\n";
         usage << "John Novembre Lab, UCLA\n";
@@ -93,6 +95,21 @@ int main(int argc, char* argv[])
             os << p;
             os.close();
         }
+        else if (function == "txt2map")
+        {
+            if (argc < 4) throw runtime_error(usage.str().c_str());
+            string filename_in = argv[2];
+            string filename_out = argv[3];
+
+            cout << "reading " << filename_in << endl << flush;
+            RecombinationMap recombination_map(filename_in);
+
+            cout << "writing " << filename_out << endl << flush;
+            ofstream os(filename_out.c_str(), ios::binary);
+            if (!os) throw runtime_error(("[forqs_aux] Unable to open file " + filename_out).c_str());
+            recombination_map.write_binary(os);
+            os.close();
+        }
         else
         {
             throw runtime_error(usage.str().c_str());
@@ -0,0 +1,798 @@
+//
+// forqs_benchmark.cpp
+//
+// Created by Darren Kessner with John Novembre
+//
+// Copyright (c) 2013 Regents of the University of California
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// * Neither UCLA nor the names of its contributors may be used to endorse or
+// promote products derived from this software without specific prior
+// written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "Population_ChromosomePairs.hpp"
+#include "RecombinationPositionGeneratorImplementation.hpp"
+#include "HaplotypeChunkIndex.hpp"
+#include "IDSet.hpp"
+#include "Genotype.hpp"
+#include "VariantIndicatorImplementation.hpp"
+#include "Random.hpp"
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <ctime>
+#include <algorithm>
+#include <set>
+#include <limits>
+
+
+using namespace std;
+using boost::lexical_cast;
+
+
+//
+// chromosome_storage: neutral Wright-Fisher generations with inline 
+// HaplotypeChunks storage disabled (before) and enabled (after)
+//
+
+
+struct StorageStats
+{
+    double bytes_per_individual;
+    double chunks_per_chromosome;
+    double inline_fraction;
+};
+
+
+StorageStats storage_stats(const Population_ChromosomePairs& p)
+{
+    size_t bytes = p.population_size() * p.chromosome_pair_count() * sizeof(ChromosomePair);
+    bytes += p.arena_size() * sizeof(HaplotypeChunk);
+
+    size_t chunk_count = 0;
+    size_t chromosome_count = 0;
+    size_t inline_count = 0;
+
+    for (ChromosomePairRangeIterator range=p.begin(); range!=p.end(); ++range)
+    for (const ChromosomePair* cp=range->begin(); cp!=range->end(); ++cp)
+    {
+        const HaplotypeChunks* chunks[] = {&cp->first.haplotype_chunks(), &cp->second.haplotype_chunks()};
+        for (size_t i=0; i<2; ++i)
+        {
+            bytes += chunks[i]->heap_bytes();
+            chunk_count += chunks[i]->size();
+            if (chunks[i]->uses_inline()) ++inline_count;
+            ++chromosome_count;
+        }
+    }
+
+    StorageStats result;
+    result.bytes_per_individual = double(bytes) / p.population_size();
+    result.chunks_per_chromosome = double(chunk_count) / chromosome_count;
+    result.inline_fraction = double(inline_count) / chromosome_count;
+    return result;
+}
+
+
+void benchmark_chromosome_storage(size_t population_size, size_t chromosome_pair_count, 
+                                  double rate, size_t generation_count)
+{
+    Population::Configs configs_gen0(1);
+    configs_gen0[0].population_size = population_size;
+    configs_gen0[0].chromosome_pair_count = chromosome_pair_count;
+
+    Population::Configs configs(1);
+    configs[0].population_size = population_size;
+    configs[0].chromosome_pair_count = chromosome_pair_count;
+    configs[0].mating_distribution.push_back(MatingDistribution::Entry(1, 0, 0));
+
+    PopulationDataPtrs population_datas(1, PopulationDataPtr(new PopulationData));
+    population_datas[0]->population_size = population_size;
+
+    vector<RecombinationPositionGenerator_Uniform::ChromosomeInfo> infos(chromosome_pair_count, 
+        RecombinationPositionGenerator_Uniform::ChromosomeInfo(100000000, rate));
+
+    RecombinationPositionGeneratorPtrs rpgs;
+    rpgs.push_back(RecombinationPositionGeneratorPtr(new RecombinationPositionGenerator_Uniform("rpg", infos)));
+    rpgs.push_back(rpgs.front());
+
+    cout << "population_size: " << population_size << endl
+         << "chromosome_pair_count: " << chromosome_pair_count << endl
+         << "rate: " << rate << endl
+         << "generation_count: " << generation_count << endl
+         << "sizeof(HaplotypeChunks): " << sizeof(HaplotypeChunks) << endl << endl;
+
+    cout << "storage\tgeneration\tseconds\tbytes_per_individual\tchunks_per_chromosome\tinline_fraction\n";
+
+    const char* labels[] = {"before", "after"};
+
+    for (size_t mode=0; mode<2; ++mode)
+    {
+        HaplotypeChunks::use_inline_storage(mode == 1);
+        Random::seed(123);
+
+        PopulationPtrsPtr populations = Population::create_populations(configs_gen0, 
+            PopulationPtrs(), PopulationDataPtrs(), rpgs);
+
+        PopulationPtrsPtr spare(new PopulationPtrs);
+        double total_seconds = 0;
+
+        for (size_t generation=1; generation<=generation_count; ++generation)
+        {
+            clock_t begin = clock();
+            PopulationPtrsPtr next = Population::create_populations(configs, *populations, population_datas, rpgs, *spare);
+            spare = populations;
+            populations = next;
+            double seconds = double(clock() - begin) / CLOCKS_PER_SEC;
+            total_seconds += seconds;
+
+            StorageStats stats = storage_stats(dynamic_cast<const Population_ChromosomePairs&>(*populations->front()));
+
+            cout << labels[mode] << "\t" << generation << "\t" << seconds << "\t" 
+                 << stats.bytes_per_individual << "\t" << stats.chunks_per_chromosome << "\t" 
+                 << stats.inline_fraction << endl;
+        }
+
+        cout << labels[mode] << "\tmean\t" << total_seconds/generation_count << endl << endl;
+    }
+
+    HaplotypeChunks::use_inline_storage(true);
+}
+
+
+//
+// chunk_search: breakpoint search kernels vs. upper_bound over HaplotypeChunks
+//
+
+
+namespace {
+struct ComparePosition
+{
+    bool operator()(const HaplotypeChunk& a, const HaplotypeChunk& b) const {return a.position < b.position;}
+};
+} // namespace
+
+
+void benchmark_chunk_search(size_t chunk_count, size_t query_count)
+{
+    Random::seed(123);
+
+    HaplotypeChunks chunks;
+    vector<unsigned int> positions;
+    for (size_t i=0; i<chunk_count; ++i)
+    {
+        unsigned int position = i==0 ? 0 : positions.back() + 1 + Random::uniform_integer(0, 100000);
+        chunks.push_back(HaplotypeChunk(position, i));
+        positions.push_back(position);
+    }
+
+    vector<unsigned int> queries;
+    for (size_t i=0; i<query_count; ++i)
+        queries.push_back(Random::uniform_integer(0, positions.back()));
+
+    cout << "chunk_count: " << chunk_count << endl
+         << "query_count: " << query_count << endl << endl;
+    cout << "kernel\tseconds\tchecksum\n";
+
+    // baseline: Chromosome::find_haplotype_chunk() implementation
+
+    clock_t begin = clock();
+    size_t checksum = 0;
+    for (vector<unsigned int>::const_iterator q=queries.begin(); q!=queries.end(); ++q)
+        checksum += (upper_bound(chunks.begin(), chunks.end(), HaplotypeChunk(*q, 0), ComparePosition()) - 1)->id;
+    cout << "upper_bound\t" << double(clock() - begin) / CLOCKS_PER_SEC << "\t" << checksum << endl;
+
+    const HaplotypeChunkIndex::Kernel kernels[] = {HaplotypeChunkIndex::Kernel_Scalar,
+                                                   HaplotypeChunkIndex::Kernel_SSE2,
+                                                   HaplotypeChunkIndex::Kernel_AVX2};
+
+    for (size_t i=0; i<sizeof(kernels)/sizeof(kernels[0]); ++i)
+    {
+        if (!HaplotypeChunkIndex::kernel_supported(kernels[i])) continue;
+        HaplotypeChunkIndex::SearchFunction search = HaplotypeChunkIndex::search_function(kernels[i]);
+
+        clock_t begin = clock();
+        size_t checksum = 0;
+        for (vector<unsigned int>::const_iterator q=queries.begin(); q!=queries.end(); ++q)
+            checksum += search(&positions[0], positions.size(), *q);
+        cout << HaplotypeChunkIndex::kernel_name(kernels[i]) << "\t" 
+             << double(clock() - begin) / CLOCKS_PER_SEC << "\t" << checksum << endl;
+    }
+}
+
+
+//
+// genotyping helpers: a variant indicator that needs no mutation tracking,
+// and a checksum for comparing genotype maps
+//
+
+
+class VariantIndicator_Parity : public VariantIndicator
+{
+    public:
+
+    VariantIndicator_Parity() : Configurable("variant_indicator_parity") {}
+
+    virtual unsigned int operator()(unsigned int chunk_id, const Locus& locus) const
+    {
+        return chunk_id & 1;
+    }
+};
+
+
+size_t genotype_checksum(const GenotypeMap& genotype_map)
+{
+    size_t result = 0;
+    Loci loci = genotype_map.loci();
+    for (Loci::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+    {
+        GenotypeDataPtr genotypes = genotype_map.get(*locus);
+        for (GenotypeData::const_iterator g=genotypes->begin(); g!=genotypes->end(); ++g)
+            result += genotype_sum(*g);
+    }
+    return result;
+}
+
+
+//
+// mating: neutral Wright-Fisher generations with 1..max_thread_count threads
+// in Population::create_organisms(); wall-clock seconds, and check that the
+// result matches the single-threaded population
+//
+
+
+void benchmark_mating(size_t population_size, size_t chromosome_pair_count, 
+                      double rate, size_t generation_count, size_t max_thread_count)
+{
+    Population::Configs configs_gen0(1);
+    configs_gen0[0].population_size = population_size;
+    configs_gen0[0].chromosome_pair_count = chromosome_pair_count;
+
+    Population::Configs configs(1);
+    configs[0].population_size = population_size;
+    configs[0].chromosome_pair_count = chromosome_pair_count;
+    configs[0].mating_distribution.push_back(MatingDistribution::Entry(1, 0, 0));
+
+    PopulationDataPtrs population_datas(1, PopulationDataPtr(new PopulationData));
+    population_datas[0]->population_size = population_size;
+
+    vector<RecombinationPositionGenerator_Uniform::ChromosomeInfo> infos(chromosome_pair_count, 
+        RecombinationPositionGenerator_Uniform::ChromosomeInfo(100000000, rate));
+
+    RecombinationPositionGeneratorPtrs rpgs;
+    rpgs.push_back(RecombinationPositionGeneratorPtr(new RecombinationPositionGenerator_Uniform("rpg", infos)));
+    rpgs.push_back(rpgs.front());
+
+    cout << "population_size: " << population_size << endl
+         << "chromosome_pair_count: " << chromosome_pair_count << endl
+         << "rate: " << rate << endl
+         << "generation_count: " << generation_count << endl << endl;
+
+    cout << "thread_count\tseconds_per_generation\tidentical\n";
+
+    PopulationPtrsPtr reference;
+
+    for (size_t thread_count=1; thread_count<=max_thread_count; ++thread_count)
+    {
+        Population::MatingOptions options;
+        options.thread_count = thread_count;
+        Random::seed(123);
+
+        PopulationPtrsPtr populations = Population::create_populations(configs_gen0, 
+            PopulationPtrs(), PopulationDataPtrs(), rpgs);
+
+        PopulationPtrsPtr spare(new PopulationPtrs);
+        boost::posix_time::ptime begin = boost::posix_time::microsec_clock::local_time();
+
+        for (size_t generation=1; generation<=generation_count; ++generation)
+        {
+            PopulationPtrsPtr next = Population::create_populations(configs, *populations, population_datas, rpgs, *spare, options);
+            spare = populations;
+            populations = next;
+        }
+
+        double seconds = (boost::posix_time::microsec_clock::local_time() - begin).total_microseconds() / 1e6;
+
+        if (!reference.get()) reference = populations;
+
+        cout << thread_count << "\t" << seconds / generation_count << "\t" 
+             << (*populations->front() == *reference->front() ? "yes" : "no") << endl;
+    }
+}
+
+
+//
+// parent_sampling: fitness-weighted draws of 2N parents per generation, by 
+// binary search in the cumulative distribution vs. alias table
+//
+
+
+void benchmark_parent_sampling(size_t population_size, size_t generation_count)
+{
+    Random::seed(123);
+    DataVector fitness(population_size);
+    for (DataVector::iterator it=fitness.begin(); it!=fitness.end(); ++it)
+        *it = Random::uniform_real(.5, 1.5);
+
+    cout << "population_size: " << population_size << endl
+         << "generation_count: " << generation_count << endl << endl;
+
+    cout << "sampler\tseconds_per_generation\tmean_index\n";
+
+    // cdf
+
+    clock_t begin = clock();
+    double index_sum = 0;
+    for (size_t generation=0; generation<generation_count; ++generation)
+    {
+        DataVectorPtr cdf = fitness.cdf();
+        for (size_t i=0; i<2*population_size; ++i)
+        {
+            double roll = Random::uniform_real(0, cdf->back());
+            index_sum += lower_bound(cdf->begin(), cdf->end(), roll) - cdf->begin();
+        }
+    }
+    cout << "cdf\t" << double(clock() - begin) / CLOCKS_PER_SEC / generation_count << "\t"
+         << index_sum / (2*population_size*generation_count) << endl;
+
+    // alias table, rebuilt each generation
+
+    begin = clock();
+    index_sum = 0;
+    Random::AliasTable table;
+    for (size_t generation=0; generation<generation_count; ++generation)
+    {
+        table.assign(fitness);
+        for (size_t i=0; i<2*population_size; ++i)
+            index_sum += table();
+    }
+    cout << "alias\t" << double(clock() - begin) / CLOCKS_PER_SEC / generation_count << "\t"
+         << index_sum / (2*population_size*generation_count) << endl;
+}
+
+
+//
+// random_indices: Random::random_indices_without_replacement() vs. the previous
+// std::set-based rejection sampler (which requires population_size in int range)
+//
+
+
+vector<size_t> random_indices_set(size_t population_size, size_t sample_size)
+{
+    set<size_t> temp;
+    while (temp.size() < sample_size)
+        temp.insert(Random::uniform_integer(0, population_size - 1));
+    return vector<size_t>(temp.begin(), temp.end());
+}
+
+
+void benchmark_random_indices(size_t population_size, size_t sample_size, size_t call_count)
+{
+    cout << "population_size: " << population_size << endl
+         << "sample_size: " << sample_size << endl
+         << "call_count: " << call_count << endl << endl;
+
+    cout << "sampler\tmicroseconds_per_call\tchecksum\n";
+
+    Random::seed(123);
+    clock_t begin = clock();
+    size_t checksum = 0;
+    for (size_t i=0; i<call_count; ++i)
+    {
+        vector<size_t> indices = Random::random_indices_without_replacement(population_size, sample_size);
+        if (!indices.empty()) checksum += indices.back() % 1000;
+    }
+    cout << "random_indices_without_replacement\t" << 1e6 * (clock() - begin) / CLOCKS_PER_SEC / call_count 
+         << "\t" << checksum << endl;
+
+    if (population_size > size_t(numeric_limits<int>::max()) || sample_size >= population_size/10.)
+        return;
+
+    Random::seed(123);
+    begin = clock();
+    checksum = 0;
+    for (size_t i=0; i<call_count; ++i)
+    {
+        vector<size_t> indices = random_indices_set(population_size, sample_size);
+        if (!indices.empty()) checksum += indices.back() % 1000;
+    }
+    cout << "set\t" << 1e6 * (clock() - begin) / CLOCKS_PER_SEC / call_count << "\t" << checksum << endl;
+}
+
+
+//
+// genotype: Genotyper search (per-locus lookups) vs. sweep (one pass per chromosome)
+//
+
+
+void benchmark_genotype(size_t population_size, size_t chromosome_pair_count, 
+                        double rate, size_t generation_count, size_t max_locus_count)
+{
+    vector<RecombinationPositionGenerator_Uniform::ChromosomeInfo> infos(chromosome_pair_count, 
+        RecombinationPositionGenerator_Uniform::ChromosomeInfo(100000000, rate));
+
+    RecombinationPositionGeneratorPtrs rpgs;
+    rpgs.push_back(RecombinationPositionGeneratorPtr(new RecombinationPositionGenerator_Uniform("rpg", infos)));
+    rpgs.push_back(rpgs.front());
+
+    Population::Configs configs_gen0(1);
+    configs_gen0[0].population_size = population_size;
+    configs_gen0[0].chromosome_pair_count = chromosome_pair_count;
+
+    Population::Configs configs(1);
+    configs[0].population_size = population_size;
+    configs[0].chromosome_pair_count = chromosome_pair_count;
+    configs[0].mating_distribution.push_back(MatingDistribution::Entry(1, 0, 0));
+
+    PopulationDataPtrs population_datas(1, PopulationDataPtr(new PopulationData));
+    population_datas[0]->population_size = population_size;
+
+    Random::seed(123);
+    PopulationPtrsPtr populations = Population::create_populations(configs_gen0, 
+        PopulationPtrs(), PopulationDataPtrs(), rpgs);
+    for (size_t generation=1; generation<=generation_count; ++generation)
+        populations = Population::create_populations(configs, *populations, population_datas, rpgs);
+
+    StorageStats stats = storage_stats(dynamic_cast<const Population_ChromosomePairs&>(*populations->front()));
+
+    cout << "population_size: " << population_size << endl
+         << "chromosome_pair_count: " << chromosome_pair_count << endl
+         << "rate: " << rate << endl
+         << "generation_count: " << generation_count << endl
+         << "chunks_per_chromosome: " << stats.chunks_per_chromosome << endl << endl;
+
+    cout << "locus_count\tmethod\tseconds\tchecksum\n";
+
+    VariantIndicator_Parity indicator;
+    Genotyper::Method methods[] = {Genotyper::Method_Search, Genotyper::Method_Sweep};
+    const char* method_names[] = {"search", "sweep"};
+
+    for (size_t locus_count=chromosome_pair_count; locus_count<=max_locus_count; locus_count*=4)
+    {
+        Loci loci;
+        while (loci.size() < locus_count)
+            loci.insert(Locus("", Random::uniform_integer(0, chromosome_pair_count-1), Random::uniform_integer(0, 100000000-1)));
+
+        for (size_t m=0; m<2; ++m)
+        {
+            Genotyper genotyper(methods[m]);
+            clock_t begin = clock();
+            GenotypeMap genotype_map;
+            genotyper.genotype(loci, *populations->front(), indicator, genotype_map);
+            double seconds = double(clock() - begin) / CLOCKS_PER_SEC;
+
+            cout << locus_count << "\t" << method_names[m] << "\t" << seconds << "\t" 
+                 << genotype_checksum(genotype_map) << endl;
+        }
+    }
+}
+
+
+//
+// poisson: per-call create_poisson_distribution() (as the mutation and
+// recombination generators used to do) vs. a cached Random::Poisson
+//
+
+
+void benchmark_poisson(double mean, size_t call_count)
+{
+    cout << "mean: " << mean << endl
+         << "call_count: " << call_count << endl << endl;
+
+    cout << "sampler\tnanoseconds_per_call\tchecksum\n";
+
+    Random::seed(123);
+    clock_t begin = clock();
+    double checksum = 0;
+    for (size_t i=0; i<call_count; ++i)
+    {
+        Random::DistributionPtr poisson = Random::create_poisson_distribution("", mean);
+        checksum += poisson->random_value();
+    }
+    cout << "create_poisson_distribution\t" << 1e9 * (clock() - begin) / CLOCKS_PER_SEC / call_count 
+         << "\t" << checksum << endl;
+
+    Random::seed(123);
+    begin = clock();
+    checksum = 0;
+    Random::Poisson poisson;
+    for (size_t i=0; i<call_count; ++i)
+    {
+        poisson.mean(mean);
+        checksum += poisson();
+    }
+    cout << "Random::Poisson\t" << 1e9 * (clock() - begin) / CLOCKS_PER_SEC / call_count 
+         << "\t" << checksum << endl;
+}
+
+
+//
+// recombination_map: RecombinationMap::random_position() (guide table) vs. 
+// binary search over the records (previous implementation)
+//
+
+
+struct HasLowerGeneticMap
+{
+    bool operator()(const RecombinationMap::Record& a, const RecombinationMap::Record& b) const
+    {
+        return a.geneticMap < b.geneticMap;
+    }
+};
+
+
+void benchmark_recombination_map(const string& filename, size_t draw_count)
+{
+    RecombinationMap recombination_map(filename);
+    const RecombinationMap::Records records = recombination_map.records();
+
+    cout << "filename: " << filename << endl
+         << "record_count: " << records.size() << endl
+         << "draw_count: " << draw_count << endl << endl;
+
+    cout << "sampler\tnanoseconds_per_draw\tchecksum\n";
+
+    Random::seed(123);
+    clock_t begin = clock();
+    size_t checksum = 0;
+    for (size_t i=0; i<draw_count; ++i)
+    {
+        double roll = Random::uniform_real(0, records.back().geneticMap);
+        RecombinationMap::Records::const_iterator it = lower_bound(records.begin(), records.end(),
+            RecombinationMap::Record(0, 0, roll), HasLowerGeneticMap());
+        checksum += Random::uniform_integer((it-1)->position, it->position - 1) % 1000;
+    }
+    cout << "binary_search\t" << 1e9 * (clock() - begin) / CLOCKS_PER_SEC / draw_count 
+         << "\t" << checksum << endl;
+
+    Random::seed(123);
+    begin = clock();
+    checksum = 0;
+    for (size_t i=0; i<draw_count; ++i)
+        checksum += recombination_map.random_position() % 1000;
+    cout << "guide_table\t" << 1e9 * (clock() - begin) / CLOCKS_PER_SEC / draw_count 
+         << "\t" << checksum << endl;
+}
+
+
+//
+// idset: membership queries on a random subset of founder ids (as built by 
+// VariantIndicator_Random), std::set vs. IDSet
+//
+
+
+void benchmark_idset(size_t id_count, double frequency, size_t query_count)
+{
+    cout << "id_count: " << id_count << endl
+         << "frequency: " << frequency << endl
+         << "query_count: " << query_count << endl << endl;
+
+    vector<size_t> indices = Random::random_indices_without_replacement(id_count, size_t(frequency * id_count));
+    vector<unsigned int> v(indices.begin(), indices.end());
+    set<unsigned int> ids_set(v.begin(), v.end());
+    IDSet ids(v);
+
+    vector<unsigned int> queries(query_count);
+    for (size_t i=0; i<query_count; ++i)
+        queries[i] = Random::uniform_integer(0, int(id_count) - 1);
+
+    cout << "representation\tnanoseconds_per_query\tchecksum\n";
+
+    clock_t begin = clock();
+    size_t checksum = 0;
+    for (size_t i=0; i<query_count; ++i)
+        checksum += ids_set.count(queries[i]);
+    cout << "std::set\t" << 1e9 * (clock() - begin) / CLOCKS_PER_SEC / query_count 
+         << "\t" << checksum << endl;
+
+    begin = clock();
+    checksum = 0;
+    for (size_t i=0; i<query_count; ++i)
+        checksum += ids.count(queries[i]);
+    cout << (ids.dense() ? "IDSet(dense)" : "IDSet(sparse)") << "\t" 
+         << 1e9 * (clock() - begin) / CLOCKS_PER_SEC / query_count << "\t" << checksum << endl;
+}
+
+
+//
+// mutable_indicator: lookups in VariantIndicator_Mutable as mutations accumulate
+// without pruning (non-recombining chromosomes, one chunk id each)
+//
+
+
+void benchmark_mutable_indicator(size_t population_size, size_t locus_count, 
+                                 double mutation_rate, size_t generation_count)
+{
+    cout << "population_size: " << population_size << endl
+         << "locus_count: " << locus_count << endl
+         << "mutation_rate: " << mutation_rate << endl
+         << "generation_count: " << generation_count << endl << endl;
+
+    const size_t chromosome_count = 2*population_size;
+
+    Loci loci;
+    for (size_t i=0; i<locus_count; ++i)
+        loci.insert(Locus("", 0, (unsigned int)(1000*(i+1))));
+
+    VariantIndicator_Mutable indicator("indicator", (unsigned int)chromosome_count);
+
+    vector<unsigned int> ids(chromosome_count);
+    for (size_t i=0; i<chromosome_count; ++i) ids[i] = (unsigned int)i;
+    vector<unsigned int> next_ids(chromosome_count);
+    vector<unsigned int> values(chromosome_count);
+
+    cout << "generation\tmutation_count\tnanoseconds_per_query\tchecksum\n";
+
+    Random::Poisson mutation_count_sampler(mutation_rate * chromosome_count * locus_count);
+    double lookup_seconds = 0;
+    size_t checksum = 0;
+
+    for (size_t generation=1; generation<=generation_count; ++generation)
+    {
+        for (size_t i=0; i<chromosome_count; ++i)
+            next_ids[i] = ids[Random::uniform_integer(0, int(chromosome_count) - 1)];
+        ids.swap(next_ids);
+
+        const size_t mutation_count = size_t(mutation_count_sampler());
+        for (size_t j=0; j<mutation_count; ++j)
+        {
+            unsigned int& id = ids[Random::uniform_integer(0, int(chromosome_count) - 1)];
+            Loci::const_iterator locus = loci.begin();
+            advance(locus, Random::uniform_integer(0, int(locus_count) - 1));
+            id = indicator.mutate(id, *locus, 1);
+        }
+
+        clock_t begin = clock();
+        for (Loci::const_iterator locus=loci.begin(); locus!=loci.end(); ++locus)
+        {
+            indicator.lookup(*locus, &ids[0], chromosome_count, &values[0]);
+            for (size_t i=0; i<chromosome_count; ++i) checksum += values[i];
+        }
+        lookup_seconds += double(clock() - begin) / CLOCKS_PER_SEC;
+
+        if (generation % (generation_count/10 ? generation_count/10 : 1) == 0)
+            cout << generation << "\t" << indicator.mutation_count() << "\t" 
+                 << 1e9 * lookup_seconds / (generation * locus_count * chromosome_count) << "\t" 
+                 << checksum << endl;
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        ostringstream usage;
+        usage << "Usage: forqs_benchmark <function> [args]\n";
+        usage << endl;
+        usage << "Functions:\n";
+        usage << "    forqs_benchmark chromosome_storage [population_size=100000] [chromosome_pair_count=4] [rate=0.5] [generation_count=20]\n";
+        usage << "    forqs_benchmark chunk_search [chunk_count=64] [query_count=10000000]\n";
+        usage << "    forqs_benchmark mating [population_size=100000] [chromosome_pair_count=4] [rate=0.5] [generation_count=10] [max_thread_count=4]\n";
+        usage << "    forqs_benchmark parent_sampling [population_size=1000000] [generation_count=5]\n";
+        usage << "    forqs_benchmark random_indices [population_size=200000000000] [sample_size=100] [call_count=10000]\n";
+        usage << "    forqs_benchmark genotype [population_size=10000] [chromosome_pair_count=4] [rate=1] [generation_count=50] [max_locus_count=16384]\n";
+        usage << "    forqs_benchmark poisson [mean=20] [call_count=10000000]\n";
+        usage << "    forqs_benchmark recombination_map [filename=../examples/genetic_map_chr21_b36.txt] [draw_count=10000000]\n";
+        usage << "    forqs_benchmark idset [id_count=20000] [frequency=0.2] [query_count=10000000]\n";
+        usage << "    forqs_benchmark mutable_indicator [population_size=10000] [locus_count=100] [mutation_rate=0.0001] [generation_count=200]\n";
+        usage << endl;
+
+        string function = argc>1 ? argv[1] : "";
+
+        if (function == "chromosome_storage")
+        {
+            size_t population_size = argc>2 ? lexical_cast<size_t>(argv[2]) : 100000;
+            size_t chromosome_pair_count = argc>3 ? lexical_cast<size_t>(argv[3]) : 4;
+            double rate = argc>4 ? lexical_cast<double>(argv[4]) : 0.5;
+            size_t generation_count = argc>5 ? lexical_cast<size_t>(argv[5]) : 20;
+            benchmark_chromosome_storage(population_size, chromosome_pair_count, rate, generation_count);
+        }
+        else if (function == "chunk_search")
+        {
+            size_t chunk_count = argc>2 ? lexical_cast<size_t>(argv[2]) : 64;
+            size_t query_count = argc>3 ? lexical_cast<size_t>(argv[3]) : 10000000;
+            benchmark_chunk_search(chunk_count, query_count);
+        }
+        else if (function == "mating")
+        {
+            size_t population_size = argc>2 ? lexical_cast<size_t>(argv[2]) : 100000;
+            size_t chromosome_pair_count = argc>3 ? lexical_cast<size_t>(argv[3]) : 4;
+            double rate = argc>4 ? lexical_cast<double>(argv[4]) : 0.5;
+            size_t generation_count = argc>5 ? lexical_cast<size_t>(argv[5]) : 10;
+            size_t max_thread_count = argc>6 ? lexical_cast<size_t>(argv[6]) : 4;
+            benchmark_mating(population_size, chromosome_pair_count, rate, generation_count, max_thread_count);
+        }
+        else if (function == "parent_sampling")
+        {
+            size_t population_size = argc>2 ? lexical_cast<size_t>(argv[2]) : 1000000;
+            size_t generation_count = argc>3 ? lexical_cast<size_t>(argv[3]) : 5;
+            benchmark_parent_sampling(population_size, generation_count);
+        }
+        else if (function == "random_indices")
+        {
+            size_t population_size = argc>2 ? lexical_cast<size_t>(argv[2]) : size_t(200000) * 1000000;
+            size_t sample_size = argc>3 ? lexical_cast<size_t>(argv[3]) : 100;
+            size_t call_count = argc>4 ? lexical_cast<size_t>(argv[4]) : 10000;
+            benchmark_random_indices(population_size, sample_size, call_count);
+        }
+        else if (function == "genotype")
+        {
+            size_t population_size = argc>2 ? lexical_cast<size_t>(argv[2]) : 10000;
+            size_t chromosome_pair_count = argc>3 ? lexical_cast<size_t>(argv[3]) : 4;
+            double rate = argc>4 ? lexical_cast<double>(argv[4]) : 1;
+            size_t generation_count = argc>5 ? lexical_cast<size_t>(argv[5]) : 50;
+            size_t max_locus_count = argc>6 ? lexical_cast<size_t>(argv[6]) : 16384;
+            benchmark_genotype(population_size, chromosome_pair_count, rate, generation_count, max_locus_count);
+        }
+        else if (function == "poisson")
+        {
+            double mean = argc>2 ? lexical_cast<double>(argv[2]) : 20;
+            size_t call_count = argc>3 ? lexical_cast<size_t>(argv[3]) : 10000000;
+            benchmark_poisson(mean, call_count);
+        }
+        else if (function == "recombination_map")
+        {
+            string filename = argc>2 ? argv[2] : "../examples/genetic_map_chr21_b36.txt";
+            size_t draw_count = argc>3 ? lexical_cast<size_t>(argv[3]) : 10000000;
+            benchmark_recombination_map(filename, draw_count);
+        }
+        else if (function == "idset")
+        {
+            size_t id_count = argc>2 ? lexical_cast<size_t>(argv[2]) : 20000;
+            double frequency = argc>3 ? lexical_cast<double>(argv[3]) : 0.2;
+            size_t query_count = argc>4 ? lexical_cast<size_t>(argv[4]) : 10000000;
+            benchmark_idset(id_count, frequency, query_count);
+        }
+        else if (function == "mutable_indicator")
+        {
+            size_t population_size = argc>2 ? lexical_cast<size_t>(argv[2]) : 10000;
+            size_t locus_count = argc>3 ? lexical_cast<size_t>(argv[3]) : 100;
+            double mutation_rate = argc>4 ? lexical_cast<double>(argv[4]) : 0.0001;
+            size_t generation_count = argc>5 ? lexical_cast<size_t>(argv[5]) : 200;
+            benchmark_mutable_indicator(population_size, locus_count, mutation_rate, generation_count);
+        }
+        else
+        {
+            throw runtime_error(usage.str().c_str());
+        }
+
+        return 0;
+    }
+    catch(exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    catch(...)
+    {
+        cerr << "Caught unknown exception.\n";
+        return 1;
+    }
+}